@@ -0,0 +1,38 @@
+#ifndef HODLR_H
+#define HODLR_H
+
+#include <stddef.h>
+#include "svd_factors.h"
+
+/* HODLR mode (hierarchical off-diagonal low rank): the image is cut into
+   2×2 blocks, the two off-diagonal blocks are stored as truncated SVDs and
+   the two diagonal blocks are cut again, down to dense leaves. Large
+   smooth regions away from the diagonal then cost only a few vectors. */
+
+typedef struct hodlr_node {
+    int r0, c0, h, w;
+    float *D;                       // leaf: the dense h×w block, NULL otherwise
+    svd_factors off[2];             // [0] top right block, [1] bottom left block
+    int rank[2];                    // vectors used of off[0] and off[1]
+    struct hodlr_node *child[2];    // [0] top left block, [1] bottom right block
+} hodlr_node;
+
+typedef struct {
+    int m, n;
+    hodlr_node *root;
+} hodlr_image;
+
+/* Builds the tree, blocks with a side of at most leaf are kept dense.
+   Off-diagonal blocks get up to max_rank vectors, fewer once their error
+   is below tol (fraction of the block's norm, 0 = always max_rank). */
+hodlr_image* hodlr_build(const float *A, int m, int n, int leaf, int max_rank, double tol);
+/* Uses at most rank vectors in every off-diagonal block (no refactoring) */
+void hodlr_set_rank(hodlr_image *h, int rank);
+/* Floats stored with the current ranks */
+size_t hodlr_floats(const hodlr_image *h);
+void hodlr_reconstruct(const hodlr_image *h, float *A_out);
+/* y = A x with A in HODLR form, x has n entries and y has m */
+void hodlr_matvec(const hodlr_image *h, const float *x, float *y);
+void hodlr_free(hodlr_image *h);
+
+#endif
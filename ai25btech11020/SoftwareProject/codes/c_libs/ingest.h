@@ -0,0 +1,20 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+/* Reading input images straight into the engine's layout: JPG, PNG, BMP,
+   TGA, GIF, PSD and PGM/PPM are decoded with stb_image and turned into
+   row major luma (Rec.601: 0.299 R + 0.587 G + 0.114 B, alpha ignored) in
+   one pass, without a temporary PGM file. */
+
+/* Reads only the header. Returns 0 on success. */
+int ingest_info(const char *path, int *rows, int *cols);
+
+/* Decodes into dst (rows×cols floats, 0..255), which the caller owns, e.g.
+   a 64 byte aligned workspace piece. rows and cols must match the file.
+   Returns 0 on success. */
+int ingest_luma(const char *path, float *dst, int rows, int cols);
+
+/* Same, 8 bit luma */
+int ingest_luma_u8(const char *path, unsigned char *dst, int rows, int cols);
+
+#endif
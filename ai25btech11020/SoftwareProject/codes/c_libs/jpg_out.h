@@ -0,0 +1,9 @@
+#ifndef JPG_OUT_H
+#define JPG_OUT_H
+
+/* Grayscale baseline JPEG straight from a float image (values clamped to
+   0..255, like write_pgm), through stb_image_write (AVX2 DCT when the CPU
+   has it). quality 1..100. Returns 0 on success. */
+int write_jpg(const char *path, const float *buf, int rows, int cols, int quality);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/* Image quality of a reconstruction against the original, computed in
+   memory right after the reconstruction (no file is read back).
+   Both images are clamped to 0..peak first, as an 8 bit file would hold them.
+
+   PSNR    = 10 log10(peak² / MSE), infinite for identical images
+   SSIM    = mean SSIM over all 11×11 windows (Gaussian weights, sigma 1.5,
+             K1 = 0.01, K2 = 0.03, as in Wang et al. 2004)
+   MS-SSIM = 5 scales with 2×2 averaging in between and the weights of
+             Wang et al. 2003; smaller images use the scales that still fit
+             an 11×11 window, with the weights scaled up to sum to 1
+
+   Results do not depend on the number of threads. SSIM and MS-SSIM are NAN
+   for images smaller than 11×11. */
+
+typedef struct {
+    double mse;
+    double psnr;
+    double ssim;
+    double msssim;
+} image_metrics;
+
+int metrics_compute(const float *ref, const float *img, int m, int n, float peak, image_metrics *out);
+
+#endif
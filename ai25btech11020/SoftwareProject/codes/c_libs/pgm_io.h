@@ -1,7 +1,11 @@
 #ifndef PGM_IO_H
 #define PGM_IO_H
 
+#include <stdio.h>
+
 float* read_pgm(const char *path, int *rows, int *cols);
 void write_pgm(const char *path, const float *buf, int rows, int cols);
+FILE* pgm_stream_open(const char *path, int *rows, int *cols);
+int pgm_stream_read_rows(FILE *f, float *buf, int count, int cols);
 
 #endif
@@ -0,0 +1,17 @@
+#ifndef PNG_FAST_H
+#define PNG_FAST_H
+
+#include <stddef.h>
+
+/* Grayscale PNG straight from a float image (values clamped to 0..255,
+   like write_pgm). The rows are cut into bands that are filtered and
+   deflated in parallel, each band ending on a byte boundary (empty stored
+   block), so the pieces join into one valid zlib stream.
+   level 0 = stored (no compression), 1..9 = faster..smaller.
+   Returns 0 on success. */
+int write_png_fast(const char *path, const float *buf, int rows, int cols, int level);
+
+/* Same, into memory (free the result with free) */
+unsigned char* png_fast_encode(const float *buf, int rows, int cols, int level, size_t *out_len);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SHARED_BASIS_H
+#define SHARED_BASIS_H
+
+/* One basis for a whole collection of m×n images of the same kind.
+   The right basis V (n×rank) spans the top eigenvectors of the sum of
+   AᵢᵀAᵢ over the collection, found with a randomized sketch that sees
+   every image once. Optionally a left basis U (m×rank) is learned the
+   same way from AᵢAᵢᵀ. Each image is then stored as
+       C = A V       (m×rank)      right basis only,  A ~ C Vᵀ
+       G = Uᵀ A V    (rank×rank)   both bases,        A ~ U G Vᵀ
+
+   Use: init, add_image for every image (pass 1), end_sketch,
+        optionally refine_image for every image (pass 2), finish,
+        then encode / decode as often as needed. */
+
+typedef struct {
+    int m, n, rank, left;
+    int l;              // rank + oversampling, columns of the sketch
+    int images;         // images seen in the current pass
+    int stage;          // 0 sketching, 1 refining, 2 ready
+
+    float *V;           // n×rank right basis
+    float *U;           // m×rank left basis (only with left)
+
+    // sketch state
+    float *Om, *Oml;    // random test matrices n×l and m×l
+    double *Zs, *Zsl;   // running sums of AᵀA Om (n×l) and A Aᵀ Oml (m×l)
+    float *Q, *Ql;      // orthonormal sketch bases
+    double *B, *Bl;     // l×l Rayleigh-Ritz sums of the refine pass (or the Nystrom estimate)
+    float *Tm, *Tn, *Tm2, *Tn2;   // scratch m×l and n×l
+} shared_basis;
+
+int shared_basis_init(shared_basis *sb, int m, int n, int rank, int oversample, int left);
+int shared_basis_add_image(shared_basis *sb, const float *A);
+int shared_basis_end_sketch(shared_basis *sb);
+int shared_basis_refine_image(shared_basis *sb, const float *A);
+int shared_basis_finish(shared_basis *sb);
+
+/* Coefficients of one image, m×rank (right basis only) or rank×rank.
+   encode and decode return -1 if their scratch could not be allocated */
+int shared_basis_coef_rows(const shared_basis *sb);
+int shared_basis_encode(const shared_basis *sb, const float *A, float *coef);
+int shared_basis_decode(const shared_basis *sb, const float *coef, float *A_out);
+
+/* Basis file: "SVDB", int m, n, rank, left, then V (n×rank) and U (m×rank) */
+int shared_basis_save(const char *path, const shared_basis *sb);
+int shared_basis_load(const char *path, shared_basis *sb);
+void shared_basis_free(shared_basis *sb);
+
+#endif
@@ -26,6 +26,8 @@ BUILDING:
    You can #define STBIW_MALLOC(), STBIW_REALLOC(), and STBIW_FREE() to replace
    malloc,realloc,free.
    You can #define STBIW_MEMMOVE() to replace memmove()
+   The JPEG writer uses an AVX2 forward DCT and quantization when the CPU has it
+   (GCC/Clang on x86, checked at run time); #define STBIW_NO_SIMD to turn it off.
    You can #define STBIW_ZLIB_COMPRESS to use a custom zlib-style compress function
    for PNG compression (instead of the builtin one), it must have the following signature:
    unsigned char * my_compress(unsigned char *data, int data_len, int *out_len, int quality);
@@ -48,6 +50,7 @@ USAGE:
      int stbi_write_bmp(char const *filename, int w, int h, int comp, const void *data);
      int stbi_write_tga(char const *filename, int w, int h, int comp, const void *data);
      int stbi_write_jpg(char const *filename, int w, int h, int comp, const void *data, int quality);
+              (comp 1 or 2 gives a one component grayscale JPEG)
      int stbi_write_hdr(char const *filename, int w, int h, int comp, const float *data);
 
      void stbi_flip_vertically_on_write(int flag); // flag is non-zero to flip data vertically
@@ -1315,6 +1318,96 @@ static void stbiw__jpg_DCT(float *d0p, float *d1p, float *d2p, float *d3p, float
    *d0p = d0;  *d2p = d2;  *d4p = d4;  *d6p = d6;
 }
 
+// AVX2 forward DCT: the same butterflies as stbiw__jpg_DCT, run on all 8
+// rows (block transposed) and then all 8 columns at once, in the C path's
+// order so the output is the same. Quantization and rounding stay in registers.
+#if !defined(STBIW_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STBIW__AVX2 1
+#include <immintrin.h>
+
+#define STBIW__TARGET_AVX2 __attribute__((target("avx2")))
+
+static STBIW__TARGET_AVX2 void stbiw__jpg_DCT_avx2(__m256 *d) {
+   __m256 tmp0 = _mm256_add_ps(d[0], d[7]), tmp7 = _mm256_sub_ps(d[0], d[7]);
+   __m256 tmp1 = _mm256_add_ps(d[1], d[6]), tmp6 = _mm256_sub_ps(d[1], d[6]);
+   __m256 tmp2 = _mm256_add_ps(d[2], d[5]), tmp5 = _mm256_sub_ps(d[2], d[5]);
+   __m256 tmp3 = _mm256_add_ps(d[3], d[4]), tmp4 = _mm256_sub_ps(d[3], d[4]);
+   __m256 tmp10, tmp11, tmp12, tmp13, z1, z2, z3, z4, z5, z11, z13;
+
+   // Even part
+   tmp10 = _mm256_add_ps(tmp0, tmp3);
+   tmp13 = _mm256_sub_ps(tmp0, tmp3);
+   tmp11 = _mm256_add_ps(tmp1, tmp2);
+   tmp12 = _mm256_sub_ps(tmp1, tmp2);
+   d[0] = _mm256_add_ps(tmp10, tmp11);
+   d[4] = _mm256_sub_ps(tmp10, tmp11);
+   z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), _mm256_set1_ps(0.707106781f));
+   d[2] = _mm256_add_ps(tmp13, z1);
+   d[6] = _mm256_sub_ps(tmp13, z1);
+
+   // Odd part
+   tmp10 = _mm256_add_ps(tmp4, tmp5);
+   tmp11 = _mm256_add_ps(tmp5, tmp6);
+   tmp12 = _mm256_add_ps(tmp6, tmp7);
+   z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), _mm256_set1_ps(0.382683433f));
+   z2 = _mm256_add_ps(_mm256_mul_ps(tmp10, _mm256_set1_ps(0.541196100f)), z5);
+   z4 = _mm256_add_ps(_mm256_mul_ps(tmp12, _mm256_set1_ps(1.306562965f)), z5);
+   z3 = _mm256_mul_ps(tmp11, _mm256_set1_ps(0.707106781f));
+   z11 = _mm256_add_ps(tmp7, z3);
+   z13 = _mm256_sub_ps(tmp7, z3);
+   d[5] = _mm256_add_ps(z13, z2);
+   d[3] = _mm256_sub_ps(z13, z2);
+   d[1] = _mm256_add_ps(z11, z4);
+   d[7] = _mm256_sub_ps(z11, z4);
+}
+
+static STBIW__TARGET_AVX2 void stbiw__transpose8_avx2(__m256 *r) {
+   __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+   __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+   __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+   __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+   __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+   __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+   __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+   __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+   r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+   r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+   r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+   r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+   r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+   r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+   r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+   r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// DU[zigzag] = round(DCT(block) * fdtbl), rounding halves away from zero like the C path
+static STBIW__TARGET_AVX2 void stbiw__jpg_dct_quant_avx2(const float *CDU, int du_stride, const float *fdtbl, int *DU) {
+   __m256 r[8];
+   int q[64], y, j;
+   const __m256 half = _mm256_set1_ps(0.5f), sign = _mm256_set1_ps(-0.0f);
+   for(y = 0; y < 8; ++y) r[y] = _mm256_loadu_ps(CDU + y*du_stride);
+   stbiw__transpose8_avx2(r);
+   stbiw__jpg_DCT_avx2(r);       // rows
+   stbiw__transpose8_avx2(r);
+   stbiw__jpg_DCT_avx2(r);       // columns
+   for(y = 0; y < 8; ++y) {
+      __m256 v = _mm256_mul_ps(r[y], _mm256_loadu_ps(fdtbl + y*8));
+      v = _mm256_add_ps(v, _mm256_or_ps(half, _mm256_and_ps(v, sign)));
+      _mm256_storeu_si256((__m256i *) (q + y*8), _mm256_cvttps_epi32(v));
+   }
+   for(j = 0; j < 64; ++j) DU[stbiw__jpg_ZigZag[j]] = q[j];
+}
+
+static int stbiw__jpg_has_avx2(void) {
+   static int has = -1;
+   if (has < 0) {
+      __builtin_cpu_init();
+      has = __builtin_cpu_supports("avx2") ? 1 : 0;
+   }
+   return has;
+}
+#endif
+
 static void stbiw__jpg_calcBits(int val, unsigned short bits[2]) {
    int tmp1 = val < 0 ? -val : val;
    val = val < 0 ? val-1 : val;
@@ -1331,6 +1424,12 @@ static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt
    int dataOff, i, j, n, diff, end0pos, x, y;
    int DU[64];
 
+#ifdef STBIW__AVX2
+   if (stbiw__jpg_has_avx2()) {
+      stbiw__jpg_dct_quant_avx2(CDU, du_stride, fdtbl, DU);
+      goto encode;
+   }
+#endif
    // DCT rows
    for(dataOff=0, n=du_stride*8; dataOff<n; dataOff+=du_stride) {
       stbiw__jpg_DCT(&CDU[dataOff], &CDU[dataOff+1], &CDU[dataOff+2], &CDU[dataOff+3], &CDU[dataOff+4], &CDU[dataOff+5], &CDU[dataOff+6], &CDU[dataOff+7]);
@@ -1352,6 +1451,9 @@ static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt
       }
    }
 
+#ifdef STBIW__AVX2
+encode:
+#endif
    // Encode DC
    diff = DU[0] - DC;
    if (diff == 0) {
@@ -1494,6 +1596,45 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       }
    }
 
+   // One component (grayscale) file: one quantization table, the two
+   // luminance Huffman tables and only Y blocks
+   if (comp <= 2) {
+      static const unsigned char head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x43,0 };
+      static const unsigned char head2[] = { 0xFF,0xDA,0,0x8,1,1,0,0,0x3F,0 };
+      const unsigned char head1[] = { 0xFF,0xC0,0,0xB,8,(unsigned char)(height>>8),STBIW_UCHAR(height),(unsigned char)(width>>8),STBIW_UCHAR(width),
+                                      1,1,0x11,0,0xFF,0xC4,0,0xD2,0 };
+      static const unsigned short fillBits[] = {0x7F, 7};
+      const unsigned char *dataG = (const unsigned char *)data;
+      int DCY=0, bitBuf=0, bitCnt=0, x, y, pos;
+
+      s->func(s->context, (void*)head0, sizeof(head0));
+      s->func(s->context, (void*)YTable, sizeof(YTable));
+      s->func(s->context, (void*)head1, sizeof(head1));
+      s->func(s->context, (void*)(std_dc_luminance_nrcodes+1), sizeof(std_dc_luminance_nrcodes)-1);
+      s->func(s->context, (void*)std_dc_luminance_values, sizeof(std_dc_luminance_values));
+      stbiw__putc(s, 0x10); // HTYACinfo
+      s->func(s->context, (void*)(std_ac_luminance_nrcodes+1), sizeof(std_ac_luminance_nrcodes)-1);
+      s->func(s->context, (void*)std_ac_luminance_values, sizeof(std_ac_luminance_values));
+      s->func(s->context, (void*)head2, sizeof(head2));
+
+      for(y = 0; y < height; y += 8) {
+         for(x = 0; x < width; x += 8) {
+            float Y[64];
+            for(row = y, pos = 0; row < y+8; ++row) {
+               int clamped_row = (row < height) ? row : height - 1;
+               int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
+               for(col = x; col < x+8; ++col, ++pos)
+                  Y[pos] = dataG[base_p + ((col < width) ? col : (width-1))*comp] - 128.0f;
+            }
+            DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y, 8, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+         }
+      }
+      stbiw__jpg_writeBits(s, &bitBuf, &bitCnt, fillBits);
+      stbiw__putc(s, 0xFF);
+      stbiw__putc(s, 0xD9);
+      return 1;
+   }
+
    // Write Headers
    {
       static const unsigned char head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x84,0 };
@@ -0,0 +1,49 @@
+#ifndef SVD_DAEMON_H
+#define SVD_DAEMON_H
+
+#include <stddef.h>
+
+/* Wire format of svd_daemon (Unix domain socket, native byte order).
+   One request per connection:
+       client -> svdd_request, then m×n 8 bit pixels unless shm is set
+       server -> svdd_reply, then reply.bytes of payload
+   With shm the client names a POSIX shared memory object that holds the
+   m×n pixels at offset 0; the result goes into the same object at
+   svdd_result_offset(m, n) and no pixels travel over the socket. */
+
+#define SVDD_OP_IMAGE   0   // rank k image, m×n bytes (rounded, clamped)
+#define SVDD_OP_FACTORS 1   // S (r floats), U (m×r), V (n×r), r = reply.rank
+#define SVDD_OP_STATS   2   // text with counters and latency percentiles
+
+#define SVDD_OK   0
+#define SVDD_BUSY 1   // queue full, try again later
+#define SVDD_BAD  2   // malformed request or size
+#define SVDD_FAIL 3   // out of memory or shm could not be mapped
+
+typedef struct {
+    char magic[4];      // "SVDQ"
+    int op;
+    int m, n;
+    int k;              // rank, or the largest rank when max_error is set
+    float max_error;    // percent, 0 = exactly rank k
+    char shm[64];       // "" or the name of the shm object, e.g. "/svdd_1234"
+} svdd_request;
+
+typedef struct {
+    char magic[4];      // "SVDR"
+    int status;
+    int rank;           // rank used
+    float error;        // percent error of the result
+    unsigned long long bytes;   // payload bytes after this header
+} svdd_reply;
+
+static inline size_t svdd_result_offset(int m, int n) {
+    return ((size_t)m * n + 63) & ~(size_t)63;
+}
+
+static inline size_t svdd_result_bytes(int op, int m, int n, int k) {
+    if (op == SVDD_OP_FACTORS) return ((size_t)k + (size_t)(m + n) * k) * sizeof(float);
+    return (size_t)m * n;
+}
+
+#endif
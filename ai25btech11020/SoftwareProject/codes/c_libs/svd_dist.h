@@ -0,0 +1,34 @@
+#ifndef SVD_DIST_H
+#define SVD_DIST_H
+
+/* Multi-process block SVD. Every process owns a band of rows of A,
+   all shared data lives in one shared memory mapping created before fork. */
+
+typedef struct svd_dist_ctl svd_dist_ctl;
+
+typedef struct {
+    int nprocs;
+    int m, n, bmax, kmax;
+
+    float *A_res;   // m×n residual (fill this before the first step)
+    float *A_app;   // m×n approximation (starts at zero)
+    float *V;       // n×b vectors of the last block step
+    float *PrevV;   // n×kmax vectors found so far
+
+    float *Y;       // m×b, A_res V of the last block step (that is U Σ)
+
+    // internal shared buffers
+    float *Z, *Zpart, *R, *Qtree, *C;
+    double *partial;
+    float *Ctmp, *ritz_prev;    // private scratch, every process has its own copy after fork
+    svd_dist_ctl *ctl;
+    void *shm;
+    size_t shm_size;
+    int *pids;
+} svd_dist_group;
+
+svd_dist_group* svd_dist_start(int nprocs, int m, int n, int bmax, int kmax);
+int svd_dist_block_step(svd_dist_group *g, int b, int max_iter, float tol);
+void svd_dist_stop(svd_dist_group *g);
+
+#endif
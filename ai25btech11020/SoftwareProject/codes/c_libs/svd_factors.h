@@ -0,0 +1,40 @@
+#ifndef SVD_FACTORS_H
+#define SVD_FACTORS_H
+
+/* Stored rank k factors A_k = U diag(S) Vᵀ and the .svdf file format:
+       "SVDF", int m, int n, int k, then S (k floats),
+       U (m×k, row major), V (n×k, row major), native byte order.
+   Any window of A_k can be rebuilt from only its rows of U and of V. */
+
+typedef struct {
+    int m, n;
+    int k;          // columns filled so far
+    int kmax;       // columns allocated (leading dimension of U and V)
+    float *S;       // k singular values
+    float *U;       // m×kmax
+    float *V;       // n×kmax
+} svd_factors;
+
+int svd_factors_init(svd_factors *f, int m, int n, int kmax);
+int svd_factors_add_block(svd_factors *f, const float *Y, const float *V, int b);
+int svd_factors_save(const char *path, const svd_factors *f);
+int svd_factors_load(const char *path, svd_factors *f);
+void svd_factors_free(svd_factors *f);
+
+/* h×w window with top left corner (r0, c0) of the rank 'rank' approximation,
+   written to out with leading dimension ld_out. Cost O(h·w·rank). */
+void svd_reconstruct_window(const svd_factors *f, int rank, int r0, int c0,
+                            int h, int w, float *out, int ld_out);
+/* Same, but reads only the needed rows of U and V straight from a .svdf file */
+int svd_factors_read_window(const char *path, int rank, int r0, int c0,
+                            int h, int w, float *out, int ld_out);
+
+/* th×tw downscaled copy of the rank 'rank' approximation. The filter is
+   applied to the rows of U (vertical) and of V (horizontal), then only the
+   small image is multiplied out, so the cost follows the thumbnail size. */
+#define SVD_THUMB_BOX 0       // average of the covered source pixels
+#define SVD_THUMB_LANCZOS 1   // Lanczos, 3 lobes
+int svd_reconstruct_thumbnail(const svd_factors *f, int rank, int th, int tw,
+                              int filter, float *out, int ld_out);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SVD_STREAM_H
+#define SVD_STREAM_H
+
+/* Largest number of rows folded in one update, bigger batches are split */
+#define SVD_STREAM_MAX_BATCH 32
+
+/* Rows of U are kept in chunks of halving size, so there are at most
+   about log2(rows) of them */
+#define SVD_STREAM_MAX_CHUNKS 40
+
+typedef struct {
+    int n;          // width of every row
+    int max_rank;   // truncation rank
+    int rows;       // rows folded in so far
+    int rank;       // current rank (<= max_rank)
+    int row_cap;    // rows allocated in U
+
+    float *U;       // rows×max_rank (leading dimension max_rank), every chunk
+                    // in its own basis until svd_stream_finalize
+    float *S;       // rank singular values, largest first
+    float *V;       // n×rank (leading dimension rank)
+
+    // row i of chunk c times W_c (chunk_w[c]×rank, leading dimension
+    // max_rank) is row i of the real U
+    int chunks;
+    int chunk_row[SVD_STREAM_MAX_CHUNKS];
+    int chunk_len[SVD_STREAM_MAX_CHUNKS];
+    int chunk_w[SVD_STREAM_MAX_CHUNKS];
+    int w_cap;      // chunks with room in W
+    float *W;       // chunk rotations, max_rank² floats each
+
+    // fixed size scratch, does not depend on the number of rows
+    float *L, *H, *J, *KT, *M, *Um, *Sm, *Vm, *VJ, *Vnew, *row_tmp;
+} svd_stream;
+
+int svd_stream_init(svd_stream *s, int n, int max_rank);
+int svd_stream_push_rows(svd_stream *s, const float *rows, int count);
+void svd_stream_finalize(svd_stream *s);
+void svd_stream_reconstruct(const svd_stream *s, float *A_out);
+void svd_stream_free(svd_stream *s);
+
+#endif
@@ -1,16 +1,36 @@
 #ifndef SVD_UTILS_H
 #define SVD_UTILS_H
 
-float norm_vec(const float *x, int n);
-void normalize_vec(float *x, int n);
-void matmul_A_V(const float *A, const float *V, float *Y, int m, int n, int b);
-void matmul_AT_Y(const float *A, const float *Y, float *Z, int m, int n, int b);
-void qr_mgs_block(float *Z, int n, int b, int ld);
-void orth_against_prev(float *V, int n, int b, float *Prev, int prev_cols, int ldp);
-void svd_block_step(float *A_res, int m, int n, int b,
-                    float *A_app,
-                    float *workV, float *workY, float *workZ,
-                    int max_iter, float tol,
-                    const float *PrevV, int prev_cols, int prev_ld);
+/* Block widths 1..SVD_MAX_FIXED_B get their own compiled kernels */
+#define SVD_MAX_FIXED_B 16
+
+/* Reproducible mode (off by default): results are bit for bit the same
+   for any number of threads. Applies to the calling thread. */
+void svd_set_reproducible(int on);
+int svd_get_reproducible(void);
+
+float vector_norm(const float *vec, int length);
+void normalize_vector(float *vec, int length);
+void matmul_A_times_V(const float *A, const float *V, float *Y, int m, int n, int b);
+void matmul_AT_times_Y(const float *A, const float *Y, float *Z, int m, int n, int b);
+void qr_modified_gram_schmidt(float *Z, int n, int b, int ld);
+void qr_modified_gram_schmidt_r(float *Z, int n, int b, int ld, float *R);
+int orthogonalize_against_prev(float *V, int n, int b,
+                               float *PrevV, int prev_cols, int ld_prev);
+int rank_update(float *C, float *R, int m, int n,
+                const float *U, const float *S, const float *V, int b, float *work);
+int ritz_converged(const float *vals, int stride, int b, float *ritz_prev, int first, float tol);
+void small_svd_jacobi(const float *M, int rows, int cols,
+                      float *U, float *S, float *V);
+int svd_block_step(float *A_res, int m, int n, int b,
+                   float *A_app,
+                   float *workV, float *workY, float *workZ,
+                   int max_iter, float tol,
+                   const float *PrevV, int prev_cols, int prev_ld, int *iters);
+int svd_block_step_chebyshev(float *A_res, int m, int n, int b,
+                             float *A_app,
+                             float *workV, float *workY, float *workZ, float *workW,
+                             int max_iter, float tol,
+                             const float *PrevV, int prev_cols, int prev_ld, int degree, int *iters);
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef SVDIMG_H
+#define SVDIMG_H
+
+#include <stddef.h>
+
+/* Library entry point for programs that want rank k approximations
+   without running ./f and exchanging files.
+
+   A context keeps the thread settings and one workspace between calls,
+   so after the first call of a given size nothing is allocated. All
+   images and results live in memory owned by the caller; strides are
+   counted in elements (floats or bytes) between the starts of two rows.
+   One context must not be used by two threads at the same time, give
+   every thread its own. Contexts share nothing: the partial sums of the
+   kernels go into a buffer of the calling thread (threads_scratch), which
+   a thread that ends early frees with threads_scratch_release(). */
+
+typedef struct svdimg_ctx svdimg_ctx;
+
+#define SVDIMG_OK      0
+#define SVDIMG_EINVAL -1   // bad size, rank, stride or NULL pointer
+#define SVDIMG_ENOMEM -2   // workspace or a block step ran out of memory
+
+typedef struct {
+    int threads;     // OpenMP threads for the kernels, 0 = OpenMP default
+    int cheb;        // Chebyshev filter degree, 1 = plain power iteration
+    int block;       // vectors per block, 1..SVD_MAX_FIXED_B
+    int max_iter;
+    float tol;
+    int hugepages;   // back the workspace with hugepages
+    double max_error;   // percent; > 0 makes k an upper bound and stops at
+                        // the first block whose error is below it
+    int reproducible;   // same bits for any thread count (svd_set_reproducible)
+} svdimg_params;
+
+void svdimg_default_params(svdimg_params *p);
+svdimg_ctx* svdimg_create(const svdimg_params *p);   // NULL params = defaults
+void svdimg_destroy(svdimg_ctx *ctx);
+/* New settings for the following calls, the workspace is kept */
+void svdimg_set_params(svdimg_ctx *ctx, const svdimg_params *p);
+const svdimg_params* svdimg_get_params(const svdimg_ctx *ctx);
+/* Rank actually used by the last call (below k when max_error stopped it;
+   for svdimg_factor only that many columns of U, S, V are written) */
+int svdimg_last_rank(const svdimg_ctx *ctx);
+
+/* Grows the workspace for m×n images up to rank k ahead of time */
+int svdimg_reserve(svdimg_ctx *ctx, int m, int n, int k);
+
+/* Rank k factors of the m×n image: U (m×k, leading dimension ldu),
+   S (k values, largest first), V (n×k, leading dimension ldv) */
+int svdimg_factor(svdimg_ctx *ctx, const float *img, int m, int n, size_t stride, int k,
+                  float *U, int ldu, float *S, float *V, int ldv);
+
+/* Rank k approximation written to out. error (may be NULL) gets
+   100·||A - A_k||_F / ||A||_F, the number in the error table.
+   out must not overlap img. */
+int svdimg_reconstruct(svdimg_ctx *ctx, const float *img, int m, int n, size_t stride, int k,
+                       float *out, size_t out_stride, double *error);
+
+/* Same for 8 bit images, the result is rounded and clamped to 0..255 */
+int svdimg_reconstruct_u8(svdimg_ctx *ctx, const unsigned char *img, int m, int n, size_t stride,
+                          int k, unsigned char *out, size_t out_stride, double *error);
+
+#endif
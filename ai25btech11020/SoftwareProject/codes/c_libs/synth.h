@@ -0,0 +1,43 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include "svd_factors.h"
+
+/* Test matrices with a prescribed spectrum: A = U diag(S) Vᵀ with
+   random orthonormal U (m×r) and V (n×r) and S following one of the
+   profiles below, so the exact factors and the best possible rank k
+   error are known. The same seed gives the same matrix on every machine
+   and with any number of threads. */
+
+#define SYNTH_EXP     0   // S_i = top · param^i           (param = decay, default 0.9)
+#define SYNTH_POWER   1   // S_i = top · (i+1)^-param      (param = alpha, default 1)
+#define SYNTH_CLUSTER 2   // groups of param equal values, halving from group to group (default 4)
+#define SYNTH_RANKDEF 3   // S_i = top · (1 - i/(2r)) for i < r, so exactly rank r
+
+typedef struct {
+    int profile;
+    int rank;            // r, number of nonzero singular values
+    double top;          // S_0
+    double param;        // see the profiles, 0 = default
+    double noise;        // standard deviation of Gaussian noise added to every entry
+    double mean;         // > 0: adds the constant matrix 'mean' as one more exact
+                         // component (u, v constant) and fits the rest into
+                         // mean ± 127, for 8 bit images; top is then ignored
+    unsigned long long seed;
+} synth_params;
+
+void synth_default_params(synth_params *p);
+int synth_profile_from_name(const char *name);   // "exp", "power", "cluster", "rankdef", -1 if unknown
+
+/* The r values of the profile, largest first */
+void synth_singular_values(const synth_params *p, float *S);
+
+/* Writes A (m×n) and, if truth is not NULL, the exact factors (truth is
+   initialised here, free with svd_factors_free). Noise is not part of the
+   truth. Returns 0 on success. */
+int synth_generate(const synth_params *p, int m, int n, float *A, svd_factors *truth);
+
+/* Smallest possible 100·||A - A_k|| / ||A|| (Eckart-Young) from the truth */
+double synth_best_error(const svd_factors *truth, int k);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stddef.h>
+
+/* Thread helpers for the kernels (OpenMP, compile with -fopenmp).
+   Without OpenMP everything runs on one thread. */
+
+int threads_count(void);
+void threads_set(int n);
+int threads_id(void);
+int threads_in_team(void);
+int threads_pin(void);
+void threads_row_range(int m, int t, int nt, int *i0, int *i1);
+float* threads_scratch(size_t floats);   // one buffer per calling thread
+void threads_scratch_release(void);
+
+/* Fill an m×n matrix so that every row band is first written by the
+   thread that owns it in the kernels (its pages land on that thread's node) */
+void first_touch_copy(float *dst, const float *src, int m, int n);
+void first_touch_zero(float *dst, int m, int n);
+
+#endif
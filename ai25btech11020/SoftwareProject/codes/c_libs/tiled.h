@@ -0,0 +1,49 @@
+#ifndef TILED_H
+#define TILED_H
+
+#include <stddef.h>
+#include "svd_factors.h"
+
+/* Tiled mode: the image is cut into tiles, every tile gets its own small
+   SVD and the ranks are then shared out between the tiles so that the
+   whole image meets a size budget or an error budget. Every tile also
+   keeps its mean (one float), the SVD is of the tile minus its mean, so
+   flat tiles end up with rank 0 or 1 and still come out right, detailed
+   ones get many vectors. */
+
+typedef struct {
+    int tile;           // tile size (square, edge tiles are smaller)
+    int quadtree;       // 1: split tiles that are still detailed at max_rank
+    int min_tile;       // smallest tile a quadtree split may produce
+    int max_rank;       // vectors computed per tile
+    double split_error; // quadtree: split if the tile's error at max_rank is above this (fraction)
+} tiled_params;
+
+typedef struct {
+    int r0, c0, h, w;
+    float mean;         // average pixel, stored with every tile
+    double energy;      // squared Frobenius norm of the tile minus its mean
+    int rank;           // rank chosen by tiled_allocate
+    svd_factors f;      // up to max_rank vectors of the tile
+} tiled_tile;
+
+typedef struct {
+    int m, n;
+    int count;
+    tiled_tile *tiles;
+} tiled_image;
+
+void tiled_default_params(tiled_params *p);
+tiled_image* tiled_factor(const float *A, int m, int n, const tiled_params *p);
+size_t tiled_allocate(tiled_image *ti, size_t float_budget, double max_error);
+void tiled_reconstruct(const tiled_image *ti, float *A_out);
+void tiled_free(tiled_image *ti);
+
+/* Truncated SVD of one h×w block of A (leading dimension lda) minus
+   shift: up to max_rank vectors, fewer once the error is below tol
+   (fraction of the block's norm). Also used by the HODLR mode.
+   Returns 0 on success. */
+int tiled_factor_block(const float *A, int lda, int r0, int c0, int h, int w, float shift,
+                       int max_rank, double tol, svd_factors *f, double *energy);
+
+#endif
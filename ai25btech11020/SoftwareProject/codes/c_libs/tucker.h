@@ -0,0 +1,31 @@
+#ifndef TUCKER_H
+#define TUCKER_H
+
+/* Truncated Tucker decomposition of a stack of t frames (m×n each),
+   seen as an m×n×t tensor X:
+       X ~ G ×1 U1 ×2 U2 ×3 U3
+   U1 (m×r1) spans the rows, U2 (n×r2) the columns, U3 (t×r3) the time
+   direction and the core G holds r3 slices of r1×r2.
+   The frames are stored one after another, frame f at X + f*m*n. */
+
+typedef struct {
+    int m, n, t;
+    int r1, r2, r3;
+    float *G;       // r3×r1×r2, slice c at G + c*r1*r2
+    float *U1;      // m×r1
+    float *U2;      // n×r2
+    float *U3;      // t×r3
+} tucker;
+
+/* HOSVD, followed by hooi_iters rounds of HOOI (0 for plain HOSVD) */
+int tucker_decompose(const float *X, int m, int n, int t, int r1, int r2, int r3,
+                     int hooi_iters, tucker *tk);
+/* Frame f (m×n) of the decomposition, -1 if out of memory */
+int tucker_decode_frame(const tucker *tk, int f, float *frame);
+
+/* File: "TUCK", int m, n, t, r1, r2, r3, then G, U1, U2, U3 as floats */
+int tucker_save(const char *path, const tucker *tk);
+int tucker_load(const char *path, tucker *tk);
+void tucker_free(tucker *tk);
+
+#endif
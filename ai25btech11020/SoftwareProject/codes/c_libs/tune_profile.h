@@ -0,0 +1,28 @@
+#ifndef TUNE_PROFILE_H
+#define TUNE_PROFILE_H
+
+/* Tuning profile written by autotune.c and read by main.c.
+   One line per measured job shape: the fastest settings found for it. */
+
+#define TUNE_MAX_ENTRIES 256
+
+typedef struct {
+    int m, n, k;        // job shape that was measured
+    int b;              // block width
+    int cheb;           // Chebyshev degree, 1 means plain power iteration
+    int procs;          // processes (svd_dist), 1 means one process
+    int threads;        // OpenMP threads for the kernels
+    double seconds;     // time of the best run
+} tune_entry;
+
+typedef struct {
+    int count;
+    tune_entry entry[TUNE_MAX_ENTRIES];
+} tune_profile;
+
+int tune_profile_load(const char *path, tune_profile *p);
+int tune_profile_save(const char *path, const tune_profile *p);
+int tune_profile_add(tune_profile *p, const tune_entry *e);
+const tune_entry* tune_profile_lookup(const tune_profile *p, int m, int n, int k);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h>
+
+/* One big block of memory handed out in 64-byte aligned pieces.
+   Sized once for the largest job, then reused without malloc/free. */
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+    int huge;     // 1 when the block is backed by hugepages
+    int mapped;   // 1 when the block came from mmap
+} workspace;
+
+int workspace_init(workspace *ws, size_t bytes, int use_hugepages);
+void* workspace_alloc(workspace *ws, size_t bytes);
+size_t workspace_mark(const workspace *ws);
+void workspace_rewind(workspace *ws, size_t mark);
+void workspace_free(workspace *ws);
+
+/* Bytes that main.c takes for one (image, k) job */
+size_t workspace_bytes_for_job(int m, int n, int k, int bmax, int cheb);
+
+#endif
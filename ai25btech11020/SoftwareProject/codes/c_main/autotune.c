@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svd_dist.h"
+#include "../c_libs/threads.h"
+#include "../c_libs/tune_profile.h"
+#include "../c_libs/synth.h"
+
+/* Autotuner: times the block SVD on synthetic matrices of typical image
+   shapes and writes the fastest settings for every (shape, k) into a
+   profile file that main.c reads with --profile.
+
+   ./autotune                      default shapes and k values
+   ./autotune --quick              only the small shapes
+   ./autotune --shape 600x800 --k 30 --out my_profile.txt */
+
+#define MAX_ITER 100
+#define TOL 1e-5f
+#define MAX_SHAPES 16
+#define MAX_KS 16
+#define REPEATS 3   // every setting is timed this often, the fastest run counts
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* Image like test matrix from synth.c: 48 exponentially falling singular
+   values (0.88 per step) on top of a mean of 128, plus a little noise, so
+   the spectrum decays like that of a photo instead of being flat */
+static int make_test_matrix(float *A, int m, int n) {
+    synth_params p;
+    synth_default_params(&p);
+    p.profile = SYNTH_EXP;
+    p.rank = 48;
+    p.param = 0.88;
+    p.mean = 128.0;
+    p.noise = 0.5;
+    p.seed = 12345;
+    return synth_generate(&p, m, n, A, NULL);
+}
+
+/* Runs one rank k job the same way main.c does and returns its time in
+   seconds (negative if it could not run). err gets ||A - A_k|| / ||A|| */
+static double run_job(const float *A, int m, int n, int k, const tune_entry *s, double *err) {
+    size_t count = (size_t)m * n;
+    int b = s->b;
+    float *A_res = (float*)malloc(count * sizeof(float));
+    float *A_app = (float*)malloc(count * sizeof(float));
+    float *V = (float*)malloc((size_t)n * b * sizeof(float));
+    float *Y = (float*)malloc((size_t)m * b * sizeof(float));
+    float *Z = (float*)malloc((size_t)n * b * sizeof(float));
+    float *W = s->cheb > 1 ? (float*)malloc((size_t)n * 2 * b * sizeof(float)) : NULL;
+    float *PrevV = (float*)calloc((size_t)n * k, sizeof(float));
+    double t = -1.0;
+    if (!A_res || !A_app || !V || !Y || !Z || (s->cheb > 1 && !W) || !PrevV)
+        goto done;
+
+    threads_set(s->threads);
+    first_touch_copy(A_res, A, m, n);
+    first_touch_zero(A_app, m, n);
+
+    double t0 = now_seconds();
+    int remaining = k, prev_cols = 0;
+    if (s->procs > 1) {
+        svd_dist_group *group = svd_dist_start(s->procs, m, n, b, k);
+        if (!group) goto done;
+        memcpy(group->A_res, A, count * sizeof(float));
+        while (remaining > 0) {
+            int curr_b = remaining < b ? remaining : b;
+            if (svd_dist_block_step(group, curr_b, MAX_ITER, TOL) < 0) {
+                svd_dist_stop(group);
+                goto done;
+            }
+            remaining -= curr_b;
+        }
+        memcpy(A_app, group->A_app, count * sizeof(float));
+        svd_dist_stop(group);
+    }
+    while (remaining > 0) {
+        int curr_b = remaining < b ? remaining : b;
+        int rc = W ? svd_block_step_chebyshev(A_res, m, n, curr_b, A_app, V, Y, Z, W,
+                                              MAX_ITER, TOL, PrevV, prev_cols, k, s->cheb, NULL)
+                   : svd_block_step(A_res, m, n, curr_b, A_app, V, Y, Z,
+                                    MAX_ITER, TOL, PrevV, prev_cols, k, NULL);
+        if (rc != 0) goto done;
+        for (int j = 0; j < curr_b; j++)
+            for (int i = 0; i < n; i++)
+                PrevV[(size_t)i * k + prev_cols + j] = V[(size_t)i * curr_b + j];
+        prev_cols += curr_b;
+        remaining -= curr_b;
+    }
+    t = now_seconds() - t0;
+
+    double num = 0.0, den = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double d = (double)A[i] - A_app[i];
+        num += d * d;
+        den += (double)A[i] * A[i];
+    }
+    *err = den > 0.0 ? sqrt(num / den) : 0.0;
+
+done:
+    free(A_res); free(A_app); free(V); free(Y); free(Z); free(W); free(PrevV);
+    return t;
+}
+
+/* Fastest of REPEATS runs, negative if the job could not run */
+static double time_job(const float *A, int m, int n, int k, const tune_entry *s, double *err) {
+    double best = -1.0;
+    for (int r = 0; r < REPEATS; r++) {
+        double t = run_job(A, m, n, k, s, err);
+        if (t < 0.0) return t;
+        if (best < 0.0 || t < best) best = t;
+    }
+    return best;
+}
+
+/* Keeps a candidate if it is faster than the best so far and not less
+   accurate than the reference run (b = SVD_MAX_FIXED_B, power iteration) */
+static void try_candidate(const float *A, int m, int n, int k, tune_entry *cand,
+                          tune_entry *best, double ref_err) {
+    double err = 0.0;
+    double t = time_job(A, m, n, k, cand, &err);
+    if (t < 0.0) return;
+    printf("  b=%-2d cheb=%d procs=%d threads=%-2d  %8.4f s  err %.6f\n",
+           cand->b, cand->cheb, cand->procs, cand->threads, t, err);
+    if (err > ref_err * 1.001 + 1e-6) return;
+    if (t < best->seconds) {
+        cand->seconds = t;
+        *best = *cand;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = "tune_profile.txt";
+    int quick = 0;
+    int shapes[MAX_SHAPES][2], num_shapes = 0;
+    int ks[MAX_KS], num_k = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) out_path = argv[++a];
+        else if (strcmp(argv[a], "--quick") == 0) quick = 1;
+        else if (strcmp(argv[a], "--shape") == 0 && a + 1 < argc && num_shapes < MAX_SHAPES) {
+            if (sscanf(argv[++a], "%dx%d", &shapes[num_shapes][0], &shapes[num_shapes][1]) == 2 &&
+                shapes[num_shapes][0] > 0 && shapes[num_shapes][1] > 0)
+                num_shapes++;
+        }
+        else if (strcmp(argv[a], "--k") == 0 && a + 1 < argc && num_k < MAX_KS) {
+            ks[num_k] = atoi(argv[++a]);
+            if (ks[num_k] > 0) num_k++;
+        }
+    }
+
+    // Default shapes: square, landscape and portrait photos of a few sizes
+    if (num_shapes == 0) {
+        const int defaults[][2] = { {256, 256}, {480, 640}, {512, 512},
+                                    {768, 1024}, {1024, 768}, {1080, 1920} };
+        int nd = quick ? 3 : 6;
+        for (int i = 0; i < nd; i++) {
+            shapes[i][0] = defaults[i][0];
+            shapes[i][1] = defaults[i][1];
+        }
+        num_shapes = nd;
+    }
+    if (num_k == 0) {
+        ks[0] = 5; ks[1] = 20; ks[2] = 50;
+        num_k = 3;
+    }
+
+    // Keep what an earlier run measured, new shapes are added, old ones replaced
+    tune_profile prof;
+    if (tune_profile_load(out_path, &prof) != 0)
+        memset(&prof, 0, sizeof(prof));
+
+    int max_threads = threads_count();
+    const int block_widths[] = { 4, 8, 12, 16 };
+    const int degrees[] = { 2, 4 };
+
+    for (int s = 0; s < num_shapes; s++) {
+        int m = shapes[s][0], n = shapes[s][1];
+        float *A = (float*)malloc((size_t)m * n * sizeof(float));
+        if (!A || make_test_matrix(A, m, n) != 0) {
+            fprintf(stderr, "Error: Cannot allocate %dx%d test matrix\n", m, n);
+            free(A);
+            continue;
+        }
+
+        for (int kc = 0; kc < num_k; kc++) {
+            int k = ks[kc];
+            if (k > m || k > n) continue;
+            printf("\n=== %dx%d, k = %d ===\n", m, n, k);
+
+            // Reference run, its first repeat also warms up caches and page tables
+            tune_entry ref = { m, n, k, SVD_MAX_FIXED_B, 1, 1, 1, 0.0 };
+            double ref_err = 0.0;
+            ref.seconds = time_job(A, m, n, k, &ref, &ref_err);
+            if (ref.seconds < 0.0) continue;
+            tune_entry best = ref;
+            printf("  reference       %8.4f s  err %.6f\n", ref.seconds, ref_err);
+
+            // Step 1: block width, one thread, power iteration
+            for (int i = 0; i < 4; i++) {
+                if (block_widths[i] == SVD_MAX_FIXED_B) continue;
+                tune_entry c = best;
+                c.b = block_widths[i];
+                try_candidate(A, m, n, k, &c, &best, ref_err);
+            }
+            // Step 2: engine with the chosen width
+            for (int i = 0; i < 2; i++) {
+                tune_entry c = best;
+                c.cheb = degrees[i];
+                try_candidate(A, m, n, k, &c, &best, ref_err);
+            }
+            // Step 3: threads, then processes, doubling up to the number of cores
+            for (int t = 2; t <= max_threads; t *= 2) {
+                tune_entry c = best;
+                c.threads = t;
+                try_candidate(A, m, n, k, &c, &best, ref_err);
+            }
+            for (int p = 2; p <= max_threads && best.cheb == 1; p *= 2) {
+                tune_entry c = best;
+                c.procs = p;
+                c.threads = 1;
+                try_candidate(A, m, n, k, &c, &best, ref_err);
+            }
+
+            printf("  best: b=%d cheb=%d procs=%d threads=%d (%.4f s)\n",
+                   best.b, best.cheb, best.procs, best.threads, best.seconds);
+            tune_profile_add(&prof, &best);
+        }
+        free(A);
+    }
+
+    if (tune_profile_save(out_path, &prof) != 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", out_path);
+        return 1;
+    }
+    printf("\nProfile with %d entries saved at %s\n", prof.count, out_path);
+    return 0;
+}
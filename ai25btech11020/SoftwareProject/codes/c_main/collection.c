@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/shared_basis.h"
+
+/* Collection mode: one shared basis for many images of the same size.
+
+   ./collection build out_dir rank [--left] [--refine] [--oversample p] a.pgm b.pgm ...
+        learns the basis (out_dir/basis.svdb) and stores every image as
+        out_dir/<name>.svdc coefficients
+   ./collection encode basis.svdb new.pgm new.svdc
+        stores one more image against an existing basis
+   ./collection decode basis.svdb img.svdc out.pgm */
+
+/* Reads a whole PGM, NULL if it is missing or has the wrong size */
+static float* load_image(const char *path, int want_m, int want_n, int *m, int *n) {
+    FILE *fp = pgm_stream_open(path, m, n);
+    if (!fp) return NULL;
+    if ((want_m && *m != want_m) || (want_n && *n != want_n)) {
+        fprintf(stderr, "Error: %s is %dx%d, the collection is %dx%d\n", path, *m, *n, want_m, want_n);
+        fclose(fp);
+        return NULL;
+    }
+    float *A = (float*)malloc((size_t)(*m) * (*n) * sizeof(float));
+    int got = A ? pgm_stream_read_rows(fp, A, *m, *n) : 0;
+    fclose(fp);
+    if (got != *m) {
+        fprintf(stderr, "Error: Cannot read %s\n", path);
+        free(A);
+        return NULL;
+    }
+    return A;
+}
+
+/* Coefficient file: "SVDC", int rows, int cols, then rows×cols floats */
+static int save_coef(const char *path, const float *coef, int rows, int cols) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        return -1;
+    }
+    int head[2] = { rows, cols };
+    size_t count = (size_t)rows * cols;
+    int bad = fwrite("SVDC", 1, 4, fp) != 4 || fwrite(head, sizeof(int), 2, fp) != 2 ||
+              fwrite(coef, sizeof(float), count, fp) != count;
+    fclose(fp);
+    return bad ? -1 : 0;
+}
+
+static float* load_coef(const char *path, int rows, int cols) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open %s\n", path);
+        return NULL;
+    }
+    char magic[4];
+    int head[2];
+    size_t count = (size_t)rows * cols;
+    float *coef = NULL;
+    if (fread(magic, 1, 4, fp) == 4 && memcmp(magic, "SVDC", 4) == 0 &&
+        fread(head, sizeof(int), 2, fp) == 2 && head[0] == rows && head[1] == cols) {
+        coef = (float*)malloc(count * sizeof(float));
+        if (coef && fread(coef, sizeof(float), count, fp) != count) {
+            free(coef);
+            coef = NULL;
+        }
+    }
+    fclose(fp);
+    if (!coef) fprintf(stderr, "Error: %s does not fit this basis\n", path);
+    return coef;
+}
+
+/* Name of the image without folders and extension */
+static void base_name(const char *path, char *out, size_t size) {
+    const char *b = path;
+    for (const char *p = path; *p; p++)
+        if (*p == '/' || *p == '\\') b = p + 1;
+    snprintf(out, size, "%s", b);
+    char *dot = strrchr(out, '.');
+    if (dot) *dot = '\0';
+}
+
+static int build(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s build out_dir rank [--left] [--refine] [--oversample p] images...\n", argv[0]);
+        return 1;
+    }
+    const char *out_dir = argv[2];
+    int rank = atoi(argv[3]), left = 0, refine = 0, oversample = 10;
+    const char *files[4096];
+    int num_files = 0;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--left") == 0) left = 1;
+        else if (strcmp(argv[a], "--refine") == 0) refine = 1;
+        else if (strcmp(argv[a], "--oversample") == 0 && a + 1 < argc) oversample = atoi(argv[++a]);
+        else if (num_files < 4096) files[num_files++] = argv[a];
+    }
+    if (rank <= 0 || num_files == 0) {
+        fprintf(stderr, "Error: need a rank > 0 and at least one image\n");
+        return 1;
+    }
+
+    int m = 0, n = 0;
+    FILE *hf = pgm_stream_open(files[0], &m, &n);
+    if (!hf) return 1;
+    fclose(hf);
+
+    shared_basis sb;
+    if (shared_basis_init(&sb, m, n, rank, oversample, left) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return 1;
+    }
+
+    // Pass 1: sketch, every image is read once
+    for (int f = 0; f < num_files; f++) {
+        int mi, ni;
+        float *A = load_image(files[f], m, n, &mi, &ni);
+        if (!A) continue;
+        shared_basis_add_image(&sb, A);
+        free(A);
+    }
+    if (shared_basis_end_sketch(&sb) != 0) {
+        fprintf(stderr, "Error: no usable images\n");
+        shared_basis_free(&sb);
+        return 1;
+    }
+    // Pass 2 (optional): Rayleigh-Ritz, sharper basis for one more read
+    for (int f = 0; refine && f < num_files; f++) {
+        int mi, ni;
+        float *A = load_image(files[f], m, n, &mi, &ni);
+        if (!A) continue;
+        shared_basis_refine_image(&sb, A);
+        free(A);
+    }
+    shared_basis_finish(&sb);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/basis.svdb", out_dir);
+    if (shared_basis_save(path, &sb) != 0) {
+        shared_basis_free(&sb);
+        return 1;
+    }
+    printf("Saved %s (%dx%d, rank %d%s)\n", path, m, n, sb.rank, left ? ", left and right" : "");
+
+    // Pass 3: coefficients of every image
+    int rows = shared_basis_coef_rows(&sb);
+    float *coef = (float*)malloc((size_t)rows * sb.rank * sizeof(float));
+    float *A_app = (float*)malloc((size_t)m * n * sizeof(float));
+    int ok = coef && A_app;
+    for (int f = 0; ok && f < num_files; f++) {
+        int mi, ni;
+        float *A = load_image(files[f], m, n, &mi, &ni);
+        if (!A) continue;
+        ok = shared_basis_encode(&sb, A, coef) == 0 && shared_basis_decode(&sb, coef, A_app) == 0;
+        if (!ok) {
+            free(A);
+            break;
+        }
+
+        double num = 0.0, den = 0.0;
+        for (size_t i = 0; i < (size_t)m * n; i++) {
+            double d = (double)A[i] - A_app[i];
+            num += d * d;
+            den += (double)A[i] * A[i];
+        }
+        char name[512];
+        base_name(files[f], name, sizeof(name));
+        snprintf(path, sizeof(path), "%s/%s.svdc", out_dir, name);
+        if (save_coef(path, coef, rows, sb.rank) == 0)
+            printf("%-40s error %8.4f %%   %d floats (image has %d)\n", path,
+                   den > 0.0 ? 100.0 * sqrt(num / den) : 0.0, rows * sb.rank, m * n);
+        free(A);
+    }
+    if (!ok) fprintf(stderr, "Error: could not allocate memory.\n");
+    free(coef);
+    free(A_app);
+    shared_basis_free(&sb);
+    return ok ? 0 : 1;
+}
+
+static int encode(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s encode basis.svdb in.pgm out.svdc\n", argv[0]);
+        return 1;
+    }
+    shared_basis sb;
+    if (shared_basis_load(argv[2], &sb) != 0) return 1;
+    int m, n, rows = shared_basis_coef_rows(&sb);
+    float *A = load_image(argv[3], sb.m, sb.n, &m, &n);
+    float *coef = (float*)malloc((size_t)rows * sb.rank * sizeof(float));
+    int ok = A && coef;
+    if (ok) {
+        ok = shared_basis_encode(&sb, A, coef) == 0 && save_coef(argv[4], coef, rows, sb.rank) == 0;
+    }
+    if (ok) printf("Saved %s\n", argv[4]);
+    free(A); free(coef);
+    shared_basis_free(&sb);
+    return ok ? 0 : 1;
+}
+
+static int decode(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s decode basis.svdb img.svdc out.pgm\n", argv[0]);
+        return 1;
+    }
+    shared_basis sb;
+    if (shared_basis_load(argv[2], &sb) != 0) return 1;
+    float *coef = load_coef(argv[3], shared_basis_coef_rows(&sb), sb.rank);
+    float *A = (float*)malloc((size_t)sb.m * sb.n * sizeof(float));
+    int ok = coef && A;
+    if (ok) ok = shared_basis_decode(&sb, coef, A) == 0;
+    if (ok) {
+        write_pgm(argv[4], A, sb.m, sb.n);
+        printf("Saved %s\n", argv[4]);
+    }
+    free(coef); free(A);
+    shared_basis_free(&sb);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "build") == 0) return build(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "encode") == 0) return encode(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "decode") == 0) return decode(argc, argv);
+    fprintf(stderr, "Usage: %s build | encode | decode ...\n", argv[0]);
+    return 1;
+}
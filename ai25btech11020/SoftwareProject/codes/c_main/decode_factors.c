@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/svd_factors.h"
+
+/* Rebuilds an image (or a crop of it) from a .svdf factor file.
+
+   ./decode_factors ../../Figs/output/imagee1_k50.svdf out.pgm
+   ./decode_factors in.svdf crop.pgm --rank 20 --roi 100 200 256 256
+                                          (top row, left column, height, width)
+   ./decode_factors in.svdf thumb.pgm --thumb 64 0 --lanczos
+                                          (height, width, 0 keeps the aspect ratio) */
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s in.svdf out.pgm [--rank r] [--roi row col height width]"
+                        " [--thumb height width [--lanczos]]\n", argv[0]);
+        return 1;
+    }
+    const char *in_path = argv[1], *out_path = argv[2];
+    int rank = 0, r0 = 0, c0 = 0, h = -1, w = -1;
+    int th = 0, tw = 0, filter = SVD_THUMB_BOX;
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "--rank") == 0 && a + 1 < argc) rank = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--roi") == 0 && a + 4 < argc) {
+            r0 = atoi(argv[++a]); c0 = atoi(argv[++a]);
+            h = atoi(argv[++a]); w = atoi(argv[++a]);
+        }
+        else if (strcmp(argv[a], "--thumb") == 0 && a + 2 < argc) {
+            th = atoi(argv[++a]); tw = atoi(argv[++a]);
+        }
+        else if (strcmp(argv[a], "--lanczos") == 0) filter = SVD_THUMB_LANCZOS;
+    }
+
+    // Only the header is needed to know the full size
+    FILE *fp = fopen(in_path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: could not open '%s'\n", in_path);
+        return 1;
+    }
+    char magic[4];
+    int head[3];
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, "SVDF", 4) != 0 ||
+        fread(head, sizeof(int), 3, fp) != 3) {
+        fprintf(stderr, "Error: %s is not a factor file\n", in_path);
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+    int m = head[0], n = head[1];
+
+    // Thumbnail: filter the factors, then multiply out only the small image
+    if (th > 0 || tw > 0) {
+        if (th <= 0) th = (int)((long long)m * tw / n);
+        if (tw <= 0) tw = (int)((long long)n * th / m);
+        if (th < 1) th = 1;
+        if (tw < 1) tw = 1;
+        svd_factors f;
+        if (svd_factors_load(in_path, &f) != 0) return 1;
+        float *thumb = (float*)malloc((size_t)th * tw * sizeof(float));
+        if (!thumb || svd_reconstruct_thumbnail(&f, rank, th, tw, filter, thumb, tw) != 0) {
+            fprintf(stderr, "Error: could not allocate memory.\n");
+            free(thumb);
+            svd_factors_free(&f);
+            return 1;
+        }
+        write_pgm(out_path, thumb, th, tw);
+        printf("Saved %dx%d thumbnail of %s -> %s\n", th, tw, in_path, out_path);
+        free(thumb);
+        svd_factors_free(&f);
+        return 0;
+    }
+    if (h < 0) { r0 = 0; h = m; }
+    if (w < 0) { c0 = 0; w = n; }
+    if (r0 < 0 || c0 < 0 || h <= 0 || w <= 0 || r0 + h > m || c0 + w > n) {
+        fprintf(stderr, "Error: window is outside the %dx%d image\n", m, n);
+        return 1;
+    }
+
+    float *out = (float*)malloc((size_t)h * w * sizeof(float));
+    if (!out) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return 1;
+    }
+    if (svd_factors_read_window(in_path, rank, r0, c0, h, w, out, w) != 0) {
+        free(out);
+        return 1;
+    }
+    write_pgm(out_path, out, h, w);
+    printf("Saved %dx%d window at (%d, %d) of %s -> %s\n", h, w, r0, c0, in_path, out_path);
+    free(out);
+    return 0;
+}
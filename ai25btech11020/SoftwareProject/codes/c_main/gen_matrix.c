@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/svd_factors.h"
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/synth.h"
+
+/* Test data with a known answer.
+
+   ./gen_matrix out m n [--profile exp|power|cluster|rankdef] [--rank r] [--top s]
+                [--param p] [--noise e] [--seed x] [--raw] [--solve k [--block b] [--cheb d]]
+        writes out.pgm (8 bit image, mean 128) or with --raw out.raw
+        (m×n float32, row major, no header), plus out_truth.svdf with the
+        exact U, S, V, and prints the best possible error for some k;
+        --solve runs the block engine of ./f up to rank k on the matrix and
+        prints the iterations of every block and the error it reached
+   ./gen_matrix check truth.svdf result.svdf
+        compares factors from ./f --factors (or any .svdf) with the truth */
+
+/* Block SVD of A (m×n) up to rank k as in main.c, with the iteration count
+   of every block next to the best error for the same rank */
+static int solve(const float *A, int m, int n, int k, int b, int cheb, const svd_factors *truth) {
+    size_t count = (size_t)m * n;
+    float *A_res = (float*)malloc(count * sizeof(float));
+    float *A_app = (float*)calloc(count, sizeof(float));
+    float *V = (float*)malloc((size_t)n * b * sizeof(float));
+    float *Y = (float*)malloc((size_t)m * b * sizeof(float));
+    float *Z = (float*)malloc((size_t)n * b * sizeof(float));
+    float *W = cheb > 1 ? (float*)malloc((size_t)n * 2 * b * sizeof(float)) : NULL;
+    float *PrevV = (float*)calloc((size_t)n * k, sizeof(float));
+    if (!A_res || !A_app || !V || !Y || !Z || (cheb > 1 && !W) || !PrevV) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        free(A_res); free(A_app); free(V); free(Y); free(Z); free(W); free(PrevV);
+        return 1;
+    }
+    double energy = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        A_res[i] = A[i];
+        energy += (double)A[i] * A[i];
+    }
+
+    const int max_iter = 100;
+    printf("Block engine (b = %d%s), at most %d iterations per block:\n", b, cheb > 1 ? ", Chebyshev" : "", max_iter);
+    printf("  block  vectors  iterations      error %%       best %%\n");
+    int prev_cols = 0, total = 0, blocks = 0;
+    while (prev_cols < k) {
+        int curr_b = k - prev_cols < b ? k - prev_cols : b, it = 0;
+        int rc = W ? svd_block_step_chebyshev(A_res, m, n, curr_b, A_app, V, Y, Z, W,
+                                              max_iter, 1e-5f, PrevV, prev_cols, k, cheb, &it)
+                   : svd_block_step(A_res, m, n, curr_b, A_app, V, Y, Z,
+                                    max_iter, 1e-5f, PrevV, prev_cols, k, &it);
+        if (rc != 0) {
+            fprintf(stderr, "Error: block %d ran out of memory\n", blocks + 1);
+            free(A_res); free(A_app); free(V); free(Y); free(Z); free(W); free(PrevV);
+            return 1;
+        }
+        for (int j = 0; j < curr_b; j++)
+            for (int i = 0; i < n; i++)
+                PrevV[(size_t)i * k + prev_cols + j] = V[(size_t)i * curr_b + j];
+        prev_cols += curr_b;
+        total += it;
+        blocks++;
+
+        double left = 0.0;
+        for (size_t i = 0; i < count; i++) left += (double)A_res[i] * A_res[i];
+        double err = energy > 0.0 ? 100.0 * sqrt(left / energy) : 0.0;
+        printf("  %5d  %7d  %10d%s  %11.4f  %11.4f\n", blocks, prev_cols, it, it >= max_iter ? "*" : " ",
+               err, prev_cols <= truth->k ? synth_best_error(truth, prev_cols) : 0.0);
+    }
+    printf("%d iterations over %d blocks (* = stopped at the limit)\n", total, blocks);
+    free(A_res); free(A_app); free(V); free(Y); free(Z); free(W); free(PrevV);
+    return 0;
+}
+
+static int generate(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s out m n [--profile exp|power|cluster|rankdef] [--rank r] [--top s]"
+                        " [--param p] [--noise e] [--seed x] [--raw] [--solve k [--block b] [--cheb d]]\n", argv[0]);
+        return 1;
+    }
+    const char *out = argv[1];
+    int m = atoi(argv[2]), n = atoi(argv[3]), raw = 0;
+    int solve_k = 0, solve_b = SVD_MAX_FIXED_B, solve_cheb = 1;
+    synth_params p;
+    synth_default_params(&p);
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) p.profile = synth_profile_from_name(argv[++a]);
+        else if (strcmp(argv[a], "--rank") == 0 && a + 1 < argc) p.rank = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--top") == 0 && a + 1 < argc) p.top = atof(argv[++a]);
+        else if (strcmp(argv[a], "--param") == 0 && a + 1 < argc) p.param = atof(argv[++a]);
+        else if (strcmp(argv[a], "--noise") == 0 && a + 1 < argc) p.noise = atof(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) p.seed = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--raw") == 0) raw = 1;
+        else if (strcmp(argv[a], "--solve") == 0 && a + 1 < argc) solve_k = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--block") == 0 && a + 1 < argc) solve_b = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--cheb") == 0 && a + 1 < argc) solve_cheb = atoi(argv[++a]);
+    }
+    if (solve_b < 1 || solve_b > SVD_MAX_FIXED_B) solve_b = SVD_MAX_FIXED_B;
+    if (solve_k > m || solve_k > n) solve_k = m < n ? m : n;
+    if (m < 1 || n < 1 || p.profile < 0) {
+        fprintf(stderr, "Error: need m, n > 0 and a known profile\n");
+        return 1;
+    }
+    // An image needs values in 0..255, so the spectrum sits on top of a constant 128
+    if (!raw) p.mean = 128.0;
+
+    float *A = (float*)malloc((size_t)m * n * sizeof(float));
+    svd_factors truth;
+    if (!A || synth_generate(&p, m, n, A, &truth) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        free(A);
+        return 1;
+    }
+
+    char path[1024];
+    int ok = 1;
+    if (raw) {
+        snprintf(path, sizeof(path), "%s.raw", out);
+        FILE *fp = fopen(path, "wb");
+        ok = fp && fwrite(A, sizeof(float), (size_t)m * n, fp) == (size_t)m * n;
+        if (fp) fclose(fp);
+    } else {
+        snprintf(path, sizeof(path), "%s.pgm", out);
+        write_pgm(path, A, m, n);
+    }
+    if (ok) printf("Saved %s (%dx%d%s)\n", path, m, n, raw ? " float32" : "");
+    snprintf(path, sizeof(path), "%s_truth.svdf", out);
+    if (ok && svd_factors_save(path, &truth) == 0)
+        printf("Saved %s (rank %d%s)\n", path, truth.k, raw ? "" : ", the first vectors are the constant 128");
+
+    // What the engines should reach: the table error can not go below these
+    printf("Best possible percentage error%s:\n", p.noise > 0.0 || !raw ? " (before noise / 8 bit rounding)" : "");
+    const int ks[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+    for (int q = 0; q < (int)(sizeof(ks) / sizeof(ks[0])) && ks[q] <= truth.k; q++)
+        printf("  k = %-4d %10.4f %%\n", ks[q], synth_best_error(&truth, ks[q]));
+
+    // The engine on the float matrix itself (no 8 bit rounding)
+    if (ok && solve_k > 0) ok = solve(A, m, n, solve_k, solve_b, solve_cheb, &truth) == 0;
+
+    svd_factors_free(&truth);
+    free(A);
+    return ok ? 0 : 1;
+}
+
+/* Singular values and vectors of an engine against the truth. Vectors of
+   equal singular values (cluster profile) can turn freely inside their
+   group, so the subspace of the first k columns is compared as well:
+   ||U_trueᵀ U||²_F / k is 1 when both span the same space. */
+static int check(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s check truth.svdf result.svdf\n", argv[0]);
+        return 1;
+    }
+    svd_factors t, r;
+    if (svd_factors_load(argv[2], &t) != 0) return 1;
+    if (svd_factors_load(argv[3], &r) != 0) {
+        svd_factors_free(&t);
+        return 1;
+    }
+    if (t.m != r.m || t.n != r.n) {
+        fprintf(stderr, "Error: %s is %dx%d, the truth is %dx%d\n", argv[3], r.m, r.n, t.m, t.n);
+        svd_factors_free(&t);
+        svd_factors_free(&r);
+        return 1;
+    }
+    int k = r.k < t.k ? r.k : t.k;
+    double worst_s = 0.0, worst_cos = 1.0, sub_u = 0.0, sub_v = 0.0;
+    printf("   i      sigma true     sigma found   rel error   |cos u|   |cos v|\n");
+    for (int i = 0; i < k; i++) {
+        double rel = t.S[i] > 0.0f ? fabs((double)r.S[i] - t.S[i]) / t.S[i] : fabs((double)r.S[i]);
+        double cu = 0.0, cv = 0.0;
+        for (int x = 0; x < t.m; x++) cu += (double)t.U[(size_t)x * t.kmax + i] * r.U[(size_t)x * r.kmax + i];
+        for (int x = 0; x < t.n; x++) cv += (double)t.V[(size_t)x * t.kmax + i] * r.V[(size_t)x * r.kmax + i];
+        cu = fabs(cu);
+        cv = fabs(cv);
+        if (rel > worst_s) worst_s = rel;
+        if (cu < worst_cos) worst_cos = cu;
+        if (cv < worst_cos) worst_cos = cv;
+        if (i < 20 || i == k - 1)
+            printf("%4d  %14.6g  %14.6g  %10.2e  %8.6f  %8.6f\n", i, t.S[i], r.S[i], rel, cu, cv);
+
+        // Column i of U_trueᵀ U and V_trueᵀ V over the first k true vectors
+        for (int j = 0; j < k; j++) {
+            double du = 0.0, dv = 0.0;
+            for (int x = 0; x < t.m; x++) du += (double)t.U[(size_t)x * t.kmax + j] * r.U[(size_t)x * r.kmax + i];
+            for (int x = 0; x < t.n; x++) dv += (double)t.V[(size_t)x * t.kmax + j] * r.V[(size_t)x * r.kmax + i];
+            sub_u += du * du;
+            sub_v += dv * dv;
+        }
+    }
+    printf("first %d: largest sigma error %.2e, smallest |cos| %.6f, subspace U %.6f, V %.6f\n",
+           k, worst_s, worst_cos, sub_u / k, sub_v / k);
+    svd_factors_free(&t);
+    svd_factors_free(&r);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "check") == 0) return check(argc, argv);
+    return generate(argc, argv);
+}
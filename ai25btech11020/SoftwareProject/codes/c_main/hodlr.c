@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../c_libs/tiled.h"
+#include "../c_libs/hodlr.h"
+
+/*HODLR tree*/
+
+// Blocks smaller than this (in pixels) are not worth a task of their own
+#define HODLR_TASK_MIN (128 * 128)
+
+static void free_node(hodlr_node *t) {
+    if (!t) return;
+    free_node(t->child[0]);
+    free_node(t->child[1]);
+    svd_factors_free(&t->off[0]);
+    svd_factors_free(&t->off[1]);
+    free(t->D);
+    free(t);
+}
+
+/* Builds the node for the h×w block at (r0, c0). The two off-diagonal
+   SVDs and the two children are independent, so each is a task.
+   Sets *failed if memory runs out. */
+static hodlr_node* build_node(const float *A, int n, int r0, int c0, int h, int w,
+                              int leaf, int max_rank, double tol, int *failed) {
+    hodlr_node *t = (hodlr_node*)calloc(1, sizeof(hodlr_node));
+    if (!t) {
+        #pragma omp atomic write
+        *failed = 1;
+        return NULL;
+    }
+    t->r0 = r0; t->c0 = c0; t->h = h; t->w = w;
+
+    if (h <= leaf || w <= leaf) {
+        t->D = (float*)malloc((size_t)h * w * sizeof(float));
+        if (!t->D) {
+            #pragma omp atomic write
+            *failed = 1;
+            return t;
+        }
+        for (int i = 0; i < h; ++i)
+            memcpy(t->D + (size_t)i * w, A + (size_t)(r0 + i) * n + c0, (size_t)w * sizeof(float));
+        return t;
+    }
+
+    int h1 = h / 2, w1 = w / 2;
+#ifdef _OPENMP
+    int big = (size_t)h * w > HODLR_TASK_MIN;
+#endif
+
+    #pragma omp task shared(t) if(big)
+    if (tiled_factor_block(A, n, r0, c0 + w1, h1, w - w1, 0.0f, max_rank, tol, &t->off[0], NULL) != 0) {
+        #pragma omp atomic write
+        *failed = 1;
+    }
+    #pragma omp task shared(t) if(big)
+    if (tiled_factor_block(A, n, r0 + h1, c0, h - h1, w1, 0.0f, max_rank, tol, &t->off[1], NULL) != 0) {
+        #pragma omp atomic write
+        *failed = 1;
+    }
+    #pragma omp task shared(t) if(big)
+    t->child[0] = build_node(A, n, r0, c0, h1, w1, leaf, max_rank, tol, failed);
+    #pragma omp task shared(t) if(big)
+    t->child[1] = build_node(A, n, r0 + h1, c0 + w1, h - h1, w - w1, leaf, max_rank, tol, failed);
+    #pragma omp taskwait
+
+    t->rank[0] = t->off[0].k;
+    t->rank[1] = t->off[1].k;
+    return t;
+}
+
+hodlr_image* hodlr_build(const float *A, int m, int n, int leaf, int max_rank, double tol) {
+    hodlr_image *hi = (hodlr_image*)calloc(1, sizeof(hodlr_image));
+    if (!hi) return NULL;
+    hi->m = m;
+    hi->n = n;
+    if (leaf < 1) leaf = 1;
+    int failed = 0;
+
+    #pragma omp parallel
+    #pragma omp single
+    hi->root = build_node(A, n, 0, 0, m, n, leaf, max_rank, tol, &failed);
+
+    if (failed || !hi->root) {
+        hodlr_free(hi);
+        return NULL;
+    }
+    return hi;
+}
+
+static void set_rank_node(hodlr_node *t, int rank) {
+    if (!t || t->D) return;
+    for (int s = 0; s < 2; ++s)
+        t->rank[s] = rank < t->off[s].k ? rank : t->off[s].k;
+    set_rank_node(t->child[0], rank);
+    set_rank_node(t->child[1], rank);
+}
+
+void hodlr_set_rank(hodlr_image *h, int rank) {
+    set_rank_node(h->root, rank < 0 ? 0 : rank);
+}
+
+static size_t floats_node(const hodlr_node *t) {
+    if (!t) return 0;
+    if (t->D) return (size_t)t->h * t->w;
+    size_t total = floats_node(t->child[0]) + floats_node(t->child[1]);
+    for (int s = 0; s < 2; ++s)
+        total += (size_t)t->rank[s] * (t->off[s].m + t->off[s].n + 1);
+    return total;
+}
+
+size_t hodlr_floats(const hodlr_image *h) {
+    return floats_node(h->root);
+}
+
+/*Reconstruction and matvec*/
+
+static void reconstruct_node(const hodlr_node *t, float *A_out, int n) {
+    float *out = A_out + (size_t)t->r0 * n + t->c0;
+    if (t->D) {
+        for (int i = 0; i < t->h; ++i)
+            memcpy(out + (size_t)i * n, t->D + (size_t)i * t->w, (size_t)t->w * sizeof(float));
+        return;
+    }
+    int h1 = t->h / 2, w1 = t->w / 2;
+#ifdef _OPENMP
+    int big = (size_t)t->h * t->w > HODLR_TASK_MIN;
+#endif
+
+    // The four quarters do not overlap
+    #pragma omp task if(big)
+    reconstruct_node(t->child[0], A_out, n);
+    #pragma omp task if(big)
+    reconstruct_node(t->child[1], A_out, n);
+
+    for (int s = 0; s < 2; ++s) {
+        float *q = s == 0 ? out + w1 : out + (size_t)h1 * n;
+        const svd_factors *f = &t->off[s];
+        if (t->rank[s] > 0) {
+            svd_reconstruct_window(f, t->rank[s], 0, 0, f->m, f->n, q, n);
+        } else {
+            for (int i = 0; i < f->m; ++i)
+                memset(q + (size_t)i * n, 0, (size_t)f->n * sizeof(float));
+        }
+    }
+    #pragma omp taskwait
+}
+
+void hodlr_reconstruct(const hodlr_image *h, float *A_out) {
+    #pragma omp parallel
+    #pragma omp single
+    reconstruct_node(h->root, A_out, h->n);
+}
+
+/* y += U diag(S) Vᵀ x for the first rank vectors: Vᵀ x first (rank dot
+   products), so the block is never multiplied out */
+static void lowrank_matvec(const svd_factors *f, int rank, const float *x, float *y) {
+    for (int j = 0; j < rank; ++j) {
+        double dot = 0.0;
+        for (int i = 0; i < f->n; ++i)
+            dot += (double)f->V[(size_t)i * f->kmax + j] * x[i];
+        float c = (float)(dot * f->S[j]);
+        for (int i = 0; i < f->m; ++i)
+            y[i] += c * f->U[(size_t)i * f->kmax + j];
+    }
+}
+
+/* The top half of y only needs the top row of blocks and the bottom half
+   the bottom row, so the two halves run as separate tasks */
+static void matvec_node(const hodlr_node *t, const float *x, float *y) {
+    if (t->D) {
+        for (int i = 0; i < t->h; ++i) {
+            const float *row = t->D + (size_t)i * t->w;
+            double sum = 0.0;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < t->w; ++j)
+                sum += (double)row[j] * x[j];
+            y[i] += (float)sum;
+        }
+        return;
+    }
+    int h1 = t->h / 2, w1 = t->w / 2;
+#ifdef _OPENMP
+    int big = (size_t)t->h * t->w > HODLR_TASK_MIN;
+#endif
+
+    #pragma omp task if(big)
+    {
+        matvec_node(t->child[0], x, y);
+        lowrank_matvec(&t->off[0], t->rank[0], x + w1, y);
+    }
+    #pragma omp task if(big)
+    {
+        matvec_node(t->child[1], x + w1, y + h1);
+        lowrank_matvec(&t->off[1], t->rank[1], x, y + h1);
+    }
+    #pragma omp taskwait
+}
+
+void hodlr_matvec(const hodlr_image *h, const float *x, float *y) {
+    memset(y, 0, (size_t)h->m * sizeof(float));
+    #pragma omp parallel
+    #pragma omp single
+    matvec_node(h->root, x, y);
+}
+
+void hodlr_free(hodlr_image *h) {
+    if (!h) return;
+    free_node(h->root);
+    free(h);
+}
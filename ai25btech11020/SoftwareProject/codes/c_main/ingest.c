@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_JPEG_PARALLEL   // threaded IDCT and colour conversion (with -fopenmp)
+#include "../c_libs/stb_image.h"
+#include "../c_libs/threads.h"
+#include "../c_libs/ingest.h"
+
+// Rec.601 luma weights in 1/65536 (they add up to 65536)
+#define LUMA_R 19595
+#define LUMA_G 38470
+#define LUMA_B 7471
+
+int ingest_info(const char *path, int *rows, int *cols) {
+    int w, h, comp;
+    if (!stbi_info(path, &w, &h, &comp)) {
+        fprintf(stderr, "Cannot read %s (%s)\n", path, stbi_failure_reason());
+        return -1;
+    }
+    *rows = h;
+    *cols = w;
+    return 0;
+}
+
+static int is_jpeg(const char *path) {
+    unsigned char magic[2] = { 0, 0 };
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t got = fread(magic, 1, 2, f);
+    fclose(f);
+    return got == 2 && magic[0] == 0xff && magic[1] == 0xd8;
+}
+
+/* Decodes the file with its own channels, NULL if it is unreadable or
+   not rows×cols. A colour JPEG already stores luma as its Y plane, so it
+   is asked for one channel: stb then skips the chroma IDCT, upsampling
+   and colour conversion. */
+static unsigned char* decode(const char *path, int rows, int cols, int *comp) {
+    int w, h, jpeg = is_jpeg(path);
+    unsigned char *px = stbi_load(path, &w, &h, comp, jpeg ? 1 : 0);
+    if (px && jpeg) *comp = 1;
+    if (!px) {
+        fprintf(stderr, "Cannot read %s (%s)\n", path, stbi_failure_reason());
+        return NULL;
+    }
+    if (w != cols || h != rows) {
+        fprintf(stderr, "%s is %dx%d, expected %dx%d\n", path, h, w, rows, cols);
+        stbi_image_free(px);
+        return NULL;
+    }
+    return px;
+}
+
+/* Rounded integer luma of pixels [i0, i1). Every channel count gets its
+   own loop with a constant stride so the compiler can vectorize it.
+   Gray (+alpha) images keep channel 0. */
+#define LUMA_LOOP(STRIDE, OUT_T)                                                  \
+    _Pragma("omp simd")                                                           \
+    for (long long i = i0; i < i1; ++i) {                                         \
+        const unsigned char *p = px + i * (STRIDE);                               \
+        dst[i] = (OUT_T)((LUMA_R * p[0] + LUMA_G * p[1] + LUMA_B * p[2] + 32768) >> 16); \
+    }
+
+static void luma_f32(const unsigned char *px, int comp, float *dst, long long i0, long long i1) {
+    if (comp == 3) { LUMA_LOOP(3, float) }
+    else if (comp == 4) { LUMA_LOOP(4, float) }
+    else {
+        #pragma omp simd
+        for (long long i = i0; i < i1; ++i)
+            dst[i] = (float)px[i * comp];
+    }
+}
+
+static void luma_u8(const unsigned char *px, int comp, unsigned char *dst, long long i0, long long i1) {
+    if (comp == 3) { LUMA_LOOP(3, unsigned char) }
+    else if (comp == 4) { LUMA_LOOP(4, unsigned char) }
+    else {
+        for (long long i = i0; i < i1; ++i)
+            dst[i] = px[i * comp];
+    }
+}
+
+/* Each thread converts its own band of rows, the same bands as in the
+   matmul kernels */
+int ingest_luma(const char *path, float *dst, int rows, int cols) {
+    int comp;
+    unsigned char *px = decode(path, rows, cols, &comp);
+    if (!px) return -1;
+
+    // One pass: channels to luma and widening to float
+    #pragma omp parallel num_threads(threads_count())
+    {
+        int r0, r1;
+        threads_row_range(rows, threads_id(), threads_in_team(), &r0, &r1);
+        luma_f32(px, comp, dst, (long long)r0 * cols, (long long)r1 * cols);
+    }
+    stbi_image_free(px);
+    return 0;
+}
+
+int ingest_luma_u8(const char *path, unsigned char *dst, int rows, int cols) {
+    int comp;
+    unsigned char *px = decode(path, rows, cols, &comp);
+    if (!px) return -1;
+
+    #pragma omp parallel num_threads(threads_count())
+    {
+        int r0, r1;
+        threads_row_range(rows, threads_id(), threads_in_team(), &r0, &r1);
+        luma_u8(px, comp, dst, (long long)r0 * cols, (long long)r1 * cols);
+    }
+    stbi_image_free(px);
+    return 0;
+}
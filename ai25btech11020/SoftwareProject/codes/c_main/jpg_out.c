@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include <stdlib.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../c_libs/stb_image_write.h"
+#include "../c_libs/jpg_out.h"
+
+int write_jpg(const char *path, const float *buf, int rows, int cols, int quality) {
+    size_t count = (size_t)rows * cols;
+    unsigned char *buf8 = (unsigned char*)malloc(count);
+    if (!buf8) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return -1;
+    }
+    // Same rounding as write_pgm
+    #pragma omp parallel for simd schedule(static)
+    for (size_t i = 0; i < count; i++) {
+        float v = buf[i];
+        v = v < 0 ? 0 : v > 255 ? 255 : v;
+        buf8[i] = (unsigned char)(v + 0.5f);
+    }
+    int ok = stbi_write_jpg(path, cols, rows, 1, buf8, quality);
+    if (!ok) fprintf(stderr, "Error: Cannot write %s\n", path);
+    free(buf8);
+    return ok ? 0 : -1;
+}
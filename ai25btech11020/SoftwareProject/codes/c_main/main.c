@@ -1,17 +1,90 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include "..\c_libs\pgm_io.h"
-#include "..\c_libs\svd_utils.h"
+#include <string.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svd_dist.h"
+#include "../c_libs/workspace.h"
+#include "../c_libs/threads.h"
+#include "../c_libs/tune_profile.h"
+#include "../c_libs/svd_factors.h"
+#include "../c_libs/tiled.h"
+#include "../c_libs/hodlr.h"
+#include "../c_libs/png_fast.h"
+#include "../c_libs/ingest.h"
+#include "../c_libs/jpg_out.h"
+#include "../c_libs/metrics.h"
+
+int main(int argc, char **argv) {
+    // number of processes for the block SVD (./f --procs 4), 1 means single process
+    int nprocs = 1;
+    // degree of the Chebyshev filter (./f --cheb 4), 1 means plain power iteration
+    int cheb_degree = 1;
+    // back the workspace with hugepages (./f --hugepages)
+    int use_hugepages = 0;
+    // threads for the kernels (./f --threads 8, needs -fopenmp) and pinning them to cores (./f --pin)
+    int nthreads = 0, pin = 0;
+    // same results bit for bit with any number of threads (./f --repro), for golden output checks
+    int reproducible = 0;
+    // settings per job from a profile written by autotune.c (./f --profile tune_profile.txt)
+    const char *profile_path = NULL;
+    // also save U, S, V of every job as a .svdf file (./f --factors)
+    int save_factors = 0;
+    // tiled mode (./f --tiled 64, add --quadtree to split detailed tiles): rank k becomes a budget of
+    // k*(m+n+1) stored floats that is shared out between the tiles;
+    // --tile-error 5 also stops spending it once the error is down to 5 %
+    tiled_params tp;
+    tiled_default_params(&tp);
+    int tiled = 0;
+    double tile_error = 0.0;
+    // HODLR mode (./f --hodlr 64): dense diagonal blocks of at most 64 pixels,
+    // every off-diagonal block in the tree gets rank k
+    int hodlr_leaf = 0;
+    // write the outputs as PNG with this zlib level instead of PGM (./f --png 6), -1 = PGM
+    int png_level = -1;
+    // or as grayscale JPEG with this quality (./f --jpg 85), for previews
+    int jpg_quality = 0;
+    // input images (./f --input a.jpg --input b.png ...), any format stb_image reads;
+    // the default is the three PGM files below
+    const char *inputs[64];
+    int num_inputs = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--procs") == 0 && a + 1 < argc) nprocs = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--cheb") == 0 && a + 1 < argc) cheb_degree = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--hugepages") == 0) use_hugepages = 1;
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nthreads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--pin") == 0) pin = 1;
+        else if (strcmp(argv[a], "--repro") == 0) reproducible = 1;
+        else if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) profile_path = argv[++a];
+        else if (strcmp(argv[a], "--factors") == 0) save_factors = 1;
+        else if (strcmp(argv[a], "--tiled") == 0 && a + 1 < argc) { tiled = 1; tp.tile = atoi(argv[++a]); }
+        else if (strcmp(argv[a], "--quadtree") == 0) tp.quadtree = 1;
+        else if (strcmp(argv[a], "--tile-error") == 0 && a + 1 < argc) tile_error = atof(argv[++a]) / 100.0;
+        else if (strcmp(argv[a], "--hodlr") == 0 && a + 1 < argc) hodlr_leaf = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--png") == 0 && a + 1 < argc) png_level = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--jpg") == 0 && a + 1 < argc) jpg_quality = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--input") == 0 && a + 1 < argc && num_inputs < 64) inputs[num_inputs++] = argv[++a];
+    }
+    if (nprocs < 1) nprocs = 1;
+    if (cheb_degree < 1) cheb_degree = 1;
+
+    tune_profile profile;
+    profile.count = 0;
+    if (profile_path && tune_profile_load(profile_path, &profile) != 0)
+        fprintf(stderr, "Warning: Cannot read profile %s, using the default settings\n", profile_path);
+    int any_cheb = cheb_degree > 1;
+    for (int i = 0; i < profile.count; i++)
+        if (profile.entry[i].cheb > 1) any_cheb = 1;
 
-int main(void) {
     // taking input of images
-    const char *input_files[] = {
+    const char *default_files[] = {
         "../../Figs/input/inputimage_1.pgm",
         "../../Figs/input/inputimage_2.pgm",
         "../../Figs/input/inputimage_3.pgm"
     };
-    const int num_images = 3;
+    const char **input_files = num_inputs > 0 ? inputs : default_files;
+    const int num_images = num_inputs > 0 ? num_inputs : 3;
 
     // taking k value as txt file i.e. input/k.txt
     int k_values[10];
@@ -38,22 +111,62 @@ int main(void) {
         return 1;
     }
 
-    fprintf(table, "------------------------------------------------------------\n");
-    fprintf(table, "|   Image   |   Rank (k)   |   Percentage Error (%%)       |\n");
-    fprintf(table, "------------------------------------------------------------\n");
+    fprintf(table, "--------------------------------------------------------------------------------------------\n");
+    fprintf(table, "|   Image   |   Rank (k)   |   Percentage Error (%%)       |  PSNR (dB)  |   SSIM   | MS-SSIM  |\n");
+    fprintf(table, "--------------------------------------------------------------------------------------------\n");
 
     srand(0); // setting seed (this will produce the same sequence of values every time)
 
+    // largest block width, a profile may pick a smaller one per job
+    const int bmax = SVD_MAX_FIXED_B;
+    const int max_iter = 100;
+    const float tol = 1e-5f;
+
+    // One workspace for the whole batch, sized for the biggest image and k
+    int kmax = 0;
+    for (int k_count = 0; k_count < num_k; k_count++)
+        if (k_values[k_count] > kmax) kmax = k_values[k_count];
+    size_t ws_bytes = 0;
+    for (int img_count = 0; img_count < num_images; img_count++) {
+        int rows, cols;
+        if (ingest_info(input_files[img_count], &rows, &cols) != 0) continue;
+        size_t job = (size_t)rows * cols * sizeof(float) + 64 +
+                     workspace_bytes_for_job(rows, cols, kmax, bmax, any_cheb);
+        if (job > ws_bytes) ws_bytes = job;
+    }
+    // Pin before anything is touched so that pages land next to their threads
+    threads_set(nthreads);
+    // Jobs without a profile entry go back to this count
+    const int default_threads = threads_count();
+    svd_set_reproducible(reproducible);
+    if (pin)
+        printf("Pinned %d of %d threads\n", threads_pin(), threads_count());
+
+    workspace ws;
+    if (workspace_init(&ws, ws_bytes, use_hugepages) != 0) {
+        fprintf(stderr, "Error: Cannot allocate %zu bytes of workspace\n", ws_bytes);
+        fclose(table);
+        return 1;
+    }
+    if (use_hugepages && !ws.huge)
+        printf("Note: no hugepages reserved, using normal pages (transparent hugepages requested)\n");
+
     for (int img_count = 0; img_count < num_images; img_count++) {
         printf("\n=== Processing Image %d: %s ===\n", img_count + 1, input_files[img_count]);
 
+        workspace_rewind(&ws, 0);
         int m, n;
-        float *src = read_pgm(input_files[img_count], &m, &n);
-        if (!src) {
+        if (ingest_info(input_files[img_count], &m, &n) != 0) {
             fprintf(stderr, "Error: Cannot read %s\n", input_files[img_count]);
             continue;
         }
+        // Decoded straight into the aligned workspace, no intermediate PGM
         size_t count = (size_t)m * n;
+        float *src = (float*)workspace_alloc(&ws, count * sizeof(float));
+        if (!src || ingest_luma(input_files[img_count], src, m, n) != 0) {
+            fprintf(stderr, "Error: Cannot read %s\n", input_files[img_count]);
+            continue;
+        }
 
         // Precompute ||A||_F
         double normA = 0.0;
@@ -61,87 +174,216 @@ int main(void) {
         normA = sqrt(normA);
         if (normA < 1e-12) normA = 1.0; // to avoid divide by zero
 
+        // Tiles are factored once per image, every k only shares out the ranks again
+        tiled_image *tiles = NULL;
+        if (tiled) {
+            tiles = tiled_factor(src, m, n, &tp);
+            if (!tiles) fprintf(stderr, "Warning: tiled mode failed for image %d, using the whole image\n", img_count + 1);
+            else printf("Tiled: %d tiles\n", tiles->count);
+        }
+        // The HODLR tree is built once with the largest k, smaller k just use fewer vectors
+        hodlr_image *tree = NULL;
+        if (hodlr_leaf > 0 && !tiles) {
+            tree = hodlr_build(src, m, n, hodlr_leaf, kmax, 0.0);
+            if (!tree) fprintf(stderr, "Warning: HODLR mode failed for image %d, using the whole image\n", img_count + 1);
+        }
+
         // Looping over k values
         for (int k_count = 0; k_count < num_k; k_count++) {
             int k = k_values[k_count];
             printf("\n--- Rank k = %d ---\n", k);
 
-            // Allocate memory for the matrices
-            float *A_res = (float*)malloc(count * sizeof(float));
-            float *A_app = (float*)calloc(count, sizeof(float));
-            for (size_t i = 0; i < count; i++) A_res[i] = src[i];
+            // Settings for this job, from the profile if there is one
+            int job_b = bmax, job_cheb = cheb_degree, job_procs = nprocs, job_threads = default_threads;
+            const tune_entry *tuned = tune_profile_lookup(&profile, m, n, k);
+            if (tuned && nthreads <= 0) job_threads = tuned->threads;
+            threads_set(job_threads);
+            if (tuned) {
+                job_b = tuned->b < bmax ? tuned->b : bmax;
+                job_cheb = tuned->cheb;
+                job_procs = tuned->procs;
+                printf("Profile: b = %d, cheb = %d, procs = %d, threads = %d\n",
+                       job_b, job_cheb, job_procs, threads_count());
+            }
 
-            const int bmax = 16;
-            float *V  = (float*)malloc((size_t)n * bmax * sizeof(float));
-            float *Y  = (float*)malloc((size_t)m * bmax * sizeof(float));
-            float *Z  = (float*)malloc((size_t)n * bmax * sizeof(float));
-            float *PrevV = (float*)calloc((size_t)n * k, sizeof(float));
+            // Take the matrices from the workspace
+            size_t job_mark = workspace_mark(&ws);
+            float *A_res = (float*)workspace_alloc(&ws, count * sizeof(float));
+            float *A_app = (float*)workspace_alloc(&ws, count * sizeof(float));
+            float *A_vis = (float*)workspace_alloc(&ws, count * sizeof(float));
+            float *V  = (float*)workspace_alloc(&ws, (size_t)n * bmax * sizeof(float));
+            float *Y  = (float*)workspace_alloc(&ws, (size_t)m * bmax * sizeof(float));
+            float *Z  = (float*)workspace_alloc(&ws, (size_t)n * bmax * sizeof(float));
+            float *W  = job_cheb > 1 ? (float*)workspace_alloc(&ws, (size_t)n * 2 * bmax * sizeof(float)) : NULL;
+            float *PrevV = (float*)workspace_alloc(&ws, (size_t)n * k * sizeof(float));
+            if (!A_res || !A_app || !A_vis || !V || !Y || !Z || (job_cheb > 1 && !W) || !PrevV) {
+                fprintf(stderr, "Error: Out of workspace for image %d, k = %d\n", img_count + 1, k);
+                workspace_rewind(&ws, job_mark);
+                continue;
+            }
+            first_touch_copy(A_res, src, m, n);
+            first_touch_zero(A_app, m, n);
+            memset(PrevV, 0, (size_t)n * k * sizeof(float));
 
             int prev_cols = 0, prev_ld = k;
-            int remaining = k, blockcount = 0;
+
+            // U, S, V are collected block by block when they are saved
+            svd_factors factors;
+            int keep_factors = save_factors && !tiles && !tree && svd_factors_init(&factors, m, n, k) == 0;
+            if (save_factors && !tiles && !tree && !keep_factors)
+                fprintf(stderr, "Warning: no memory to keep the factors of image %d, k = %d\n", img_count + 1, k);
+            int remaining = k, blockcount = 0, iterations = 0, failed = 0;
+
+            // Tiled: the same storage as rank k, spent where the image needs it
+            if (tiles) {
+                size_t used = tiled_allocate(tiles, (size_t)k * (m + n + 1), tile_error);
+                tiled_reconstruct(tiles, A_app);
+                int rmin = tiles->tiles[0].rank, rmax = rmin;
+                for (int t = 1; t < tiles->count; t++) {
+                    if (tiles->tiles[t].rank < rmin) rmin = tiles->tiles[t].rank;
+                    if (tiles->tiles[t].rank > rmax) rmax = tiles->tiles[t].rank;
+                }
+                printf("Tiled: ranks %d..%d, %zu of %zu floats\n", rmin, rmax, used, (size_t)k * (m + n + 1));
+                remaining = 0;
+            }
+            if (tree) {
+                hodlr_set_rank(tree, k);
+                hodlr_reconstruct(tree, A_app);
+                printf("HODLR: %zu floats (rank %d SVD: %zu)\n", hodlr_floats(tree), k, (size_t)k * (m + n + 1));
+                remaining = 0;
+            }
+
+            // Row bands of A spread over several processes
+            svd_dist_group *group = NULL;
+            if (job_procs > 1 && remaining > 0) {
+                group = svd_dist_start(job_procs, m, n, job_b, k);
+                if (!group) fprintf(stderr, "Warning: could not start %d processes, using one\n", job_procs);
+                else memcpy(group->A_res, src, count * sizeof(float));
+            }
+            while (group && remaining > 0) {
+                int curr_b = remaining < job_b ? remaining : job_b;
+                int it = svd_dist_block_step(group, curr_b, max_iter, tol);
+                if (it < 0) {
+                    failed = 1;
+                    break;
+                }
+                printf("Block %d: extracting %d vectors (remaining %d) on %d processes, %d iterations\n",
+                       blockcount + 1, curr_b, remaining, job_procs, it);
+                iterations += it;
+                if (keep_factors)
+                    svd_factors_add_block(&factors, group->Y, group->V, curr_b);
+                remaining -= curr_b;
+                blockcount++;
+            }
+            if (group) {
+                if (!failed) memcpy(A_app, group->A_app, count * sizeof(float));
+                svd_dist_stop(group);
+            }
 
             // Block SVD
-            while (remaining > 0) {
-                int curr_b = remaining < bmax ? remaining : bmax;
-                printf("Block %d: extracting %d vectors (remaining %d)\n",
-                       blockcount + 1, curr_b, remaining);
-                svd_block_step(A_res, m, n, curr_b, A_app, V, Y, Z,
-                               100, 1e-5f, PrevV, prev_cols, prev_ld);
+            while (!failed && remaining > 0) {
+                int curr_b = remaining < job_b ? remaining : job_b, it = 0;
+                int rc = W ? svd_block_step_chebyshev(A_res, m, n, curr_b, A_app, V, Y, Z, W,
+                                                      max_iter, tol, PrevV, prev_cols, prev_ld, job_cheb, &it)
+                           : svd_block_step(A_res, m, n, curr_b, A_app, V, Y, Z,
+                                            max_iter, tol, PrevV, prev_cols, prev_ld, &it);
+                if (rc != 0) {
+                    failed = 1;
+                    break;
+                }
+                printf("Block %d: extracting %d vectors (remaining %d), %d iterations\n",
+                       blockcount + 1, curr_b, remaining, it);
+                iterations += it;
+                if (keep_factors)
+                    svd_factors_add_block(&factors, Y, V, curr_b);
 
                 // Coping current V into PrevV
                 for (int j = 0; j < curr_b; j++)
                     for (int i = 0; i < n; i++)
-                        PrevV[(size_t)i * prev_ld + (prev_cols + j)] = V[(size_t)i * bmax + j];
+                        PrevV[(size_t)i * prev_ld + (prev_cols + j)] = V[(size_t)i * curr_b + j];
 
                 prev_cols += curr_b;
                 remaining -= curr_b;
                 blockcount++;
             }
+            // A block that ran out of memory leaves a partial A_app, no row for it
+            if (failed) {
+                fprintf(stderr, "Error: block %d ran out of memory for image %d, k = %d\n",
+                        blockcount + 1, img_count + 1, k);
+                if (keep_factors) svd_factors_free(&factors);
+                workspace_rewind(&ws, job_mark);
+                continue;
+            }
 
-            //Calculating percentage error using RAW A_app (before scaling)
+            //Calculating percentage error using RAW A_app (before scaling),
+            //min and max for the scaled copy are found in the same pass
             double diff_norm = 0.0;
+            float minv = A_app[0], maxv = A_app[0];
             for (size_t i = 0; i < count; i++) {
                 double a = (double)src[i];
                 double ak = (double)A_app[i];
                 double d = a - ak;
                 diff_norm += d * d;
+                if (A_app[i] < minv) minv = A_app[i];
+                if (A_app[i] > maxv) maxv = A_app[i];
             }
             diff_norm = sqrt(diff_norm);
             double percent_error = (diff_norm / normA) * 100.0;
 
-            printf("Percentage error (k=%d): %.4f%%\n", k, percent_error);
-            fprintf(table, "|  image%-4d | %8d   | %25.4f |\n", img_count + 1, k, percent_error);
-
-            //Creating a scaled copy for saving
-            float *A_vis = (float*)malloc(count * sizeof(float));
-            float minv = A_app[0], maxv = A_app[0];
-            for (size_t i = 1; i < count; i++) {
-                if (A_app[i] < minv) minv = A_app[i];
-                if (A_app[i] > maxv) maxv = A_app[i];
-            }
+            //Creating a scaled copy for saving, already rounded to the
+            //8 bit values the writers store, so the metrics see the same pixels
             double range = (double)(maxv - minv);
             if (range < 1e-6) range = 1.0;
             for (size_t i = 0; i < count; i++) {
                 double v = ((double)A_app[i] - minv) / range;
-                A_vis[i] = (float)(255.0 * v);
+                A_vis[i] = (float)(unsigned char)((float)(255.0 * v) + 0.5f);
             }
 
+            // PSNR, SSIM and MS-SSIM of the saved image against the input, in one
+            // pass. The percentage error above is on the raw A_app instead
+            image_metrics qm;
+            if (metrics_compute(src, A_vis, m, n, 255.0f, &qm) != 0)
+                qm.psnr = qm.ssim = qm.msssim = NAN;
+
+            if (blockcount > 0)
+                printf("Iterations: %d over %d blocks (at most %d each)\n", iterations, blockcount, max_iter);
+            printf("Percentage error (k=%d): %.4f%%\n", k, percent_error);
+            printf("PSNR %.2f dB, SSIM %.5f, MS-SSIM %.5f\n", qm.psnr, qm.ssim, qm.msssim);
+            fprintf(table, "|  image%-4d | %8d   | %25.4f | %11.4f | %8.5f | %8.5f |\n",
+                    img_count + 1, k, percent_error, qm.psnr, qm.ssim, qm.msssim);
+
             // Write image
             char outname[256];
-            sprintf(outname, "../../Figs/output/imagee%d_k%d.pgm", img_count + 1, k);
-            write_pgm(outname, A_vis, m, n);
-            printf("Saved %s\n", outname);
-
-            //Free memory
-            free(A_vis);
-            free(A_res); free(A_app);
-            free(V); free(Y); free(Z); free(PrevV);
-        }
+            if (jpg_quality > 0) {
+                sprintf(outname, "../../Figs/output/imagee%d_k%d.jpg", img_count + 1, k);
+                if (write_jpg(outname, A_vis, m, n, jpg_quality) == 0)
+                    printf("Saved %s\n", outname);
+            } else if (png_level >= 0) {
+                sprintf(outname, "../../Figs/output/imagee%d_k%d.png", img_count + 1, k);
+                if (write_png_fast(outname, A_vis, m, n, png_level) == 0)
+                    printf("Saved %s\n", outname);
+            } else {
+                sprintf(outname, "../../Figs/output/imagee%d_k%d.pgm", img_count + 1, k);
+                write_pgm(outname, A_vis, m, n);
+                printf("Saved %s\n", outname);
+            }
 
-        free(src);
+            if (keep_factors) {
+                sprintf(outname, "../../Figs/output/imagee%d_k%d.svdf", img_count + 1, k);
+                if (svd_factors_save(outname, &factors) == 0)
+                    printf("Saved %s\n", outname);
+                svd_factors_free(&factors);
+            }
+
+            //Give the job's memory back to the workspace
+            workspace_rewind(&ws, job_mark);
+        }
+        tiled_free(tiles);
+        hodlr_free(tree);
     }
+    workspace_free(&ws);
 
-    fprintf(table, "------------------------------------------------------------\n");
+    fprintf(table, "--------------------------------------------------------------------------------------------\n");
     fclose(table);
 
     printf("\n All images processed successfully!\n");
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/threads.h"
+#include "../c_libs/metrics.h"
+
+/*Image quality metrics*/
+
+#define SSIM_WIN 11
+#define MS_SCALES 5
+
+static const double ms_weight[MS_SCALES] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+
+static void gauss_window(float *w) {
+    double d[SSIM_WIN], sum = 0.0;
+    for (int i = 0; i < SSIM_WIN; i++) {
+        double t = i - SSIM_WIN / 2;
+        d[i] = exp(-t * t / (2.0 * 1.5 * 1.5));
+        sum += d[i];
+    }
+    for (int i = 0; i < SSIM_WIN; i++) w[i] = (float)(d[i] / sum);
+}
+
+static void clamp_row(const float *src, float *dst, int n, float peak) {
+    #pragma omp simd
+    for (int j = 0; j < n; j++) {
+        float v = src[j];
+        dst[j] = v < 0.0f ? 0.0f : v > peak ? peak : v;
+    }
+}
+
+/* Horizontal pass of one row: the weighted sums of x, y, x², y² and xy
+   over every 11 wide window, W = n - 10 values each, one after the other */
+static void hfilter_row(const float *x, const float *y, int n, const float *w, float *out) {
+    int W = n - SSIM_WIN + 1;
+    float *mx = out, *my = out + W, *xx = out + 2 * W, *yy = out + 3 * W, *xy = out + 4 * W;
+    #pragma omp simd
+    for (int j = 0; j < W; j++) {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f, s4 = 0.0f;
+        for (int t = 0; t < SSIM_WIN; t++) {
+            float a = x[j + t], b = y[j + t], wt = w[t];
+            s0 += wt * a;
+            s1 += wt * b;
+            s2 += wt * a * a;
+            s3 += wt * b * b;
+            s4 += wt * a * b;
+        }
+        mx[j] = s0; my[j] = s1; xx[j] = s2; yy[j] = s3; xy[j] = s4;
+    }
+}
+
+/* SSIM of one scale. Every thread takes a band of output rows, runs the
+   horizontal pass over its input rows into a ring of 11 filtered rows and
+   the vertical pass straight out of the ring, so the five local statistics
+   are never stored for the whole image. Sums go per output row into
+   row_s / row_c and are added in order, so the thread count does not
+   matter. With row_mse the squared error of every input row is taken on
+   the way (each row by the one thread whose band starts there). */
+static int ssim_scale(const float *x, const float *y, int m, int n, float peak, const float *w,
+                      double *row_s, double *row_c, double *row_mse, double *ssim, double *cs) {
+    int M = m - SSIM_WIN + 1, W = n - SSIM_WIN + 1;
+    float C1 = (0.01f * peak) * (0.01f * peak), C2 = (0.03f * peak) * (0.03f * peak);
+    int failed = 0;
+
+    #pragma omp parallel num_threads(threads_count())
+    {
+        int r0, r1;
+        threads_row_range(M, threads_id(), threads_in_team(), &r0, &r1);
+        int last = threads_id() == threads_in_team() - 1;
+        float *buf = r1 > r0 ? (float*)malloc(((size_t)2 * n + (size_t)SSIM_WIN * 5 * W) * sizeof(float)) : NULL;
+        if (r1 > r0 && !buf) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        float *cx = buf, *cy = buf + n, *ring = buf + 2 * n;
+
+        for (int i = r0; buf && i < r1 + SSIM_WIN - 1; i++) {
+            clamp_row(x + (size_t)i * n, cx, n, peak);
+            clamp_row(y + (size_t)i * n, cy, n, peak);
+            if (row_mse && (i < r1 || (last && i >= M))) {
+                double e = 0.0;
+                #pragma omp simd reduction(+:e)
+                for (int j = 0; j < n; j++) {
+                    float d = cx[j] - cy[j];
+                    e += (double)(d * d);
+                }
+                row_mse[i] = e;
+            }
+            hfilter_row(cx, cy, n, w, ring + (size_t)(i % SSIM_WIN) * 5 * W);
+
+            int r = i - (SSIM_WIN - 1);
+            if (r < r0) continue;
+            const float *rows[SSIM_WIN];
+            for (int t = 0; t < SSIM_WIN; t++)
+                rows[t] = ring + (size_t)((r + t) % SSIM_WIN) * 5 * W;
+
+            double s_sum = 0.0, c_sum = 0.0;
+            #pragma omp simd reduction(+:s_sum, c_sum)
+            for (int j = 0; j < W; j++) {
+                float mx = 0.0f, my = 0.0f, xx = 0.0f, yy = 0.0f, xy = 0.0f;
+                for (int t = 0; t < SSIM_WIN; t++) {
+                    const float *q = rows[t];
+                    float wt = w[t];
+                    mx += wt * q[j];
+                    my += wt * q[W + j];
+                    xx += wt * q[2 * W + j];
+                    yy += wt * q[3 * W + j];
+                    xy += wt * q[4 * W + j];
+                }
+                float vx = xx - mx * mx, vy = yy - my * my, cov = xy - mx * my;
+                float c = (2.0f * cov + C2) / (vx + vy + C2);
+                float l = (2.0f * mx * my + C1) / (mx * mx + my * my + C1);
+                s_sum += (double)(l * c);
+                c_sum += (double)c;
+            }
+            row_s[r] = s_sum;
+            row_c[r] = c_sum;
+        }
+        free(buf);
+    }
+    if (failed) return -1;
+
+    double s = 0.0, c = 0.0;
+    for (int r = 0; r < M; r++) {
+        s += row_s[r];
+        c += row_c[r];
+    }
+    *ssim = s / ((double)M * W);
+    *cs = c / ((double)M * W);
+    return 0;
+}
+
+/* 2×2 average, the source is clamped on the way (the first scale is not) */
+static void downsample(const float *src, int m, int n, float *dst, float peak) {
+    int m2 = m / 2, n2 = n / 2;
+    #pragma omp parallel for schedule(static) num_threads(threads_count())
+    for (int i = 0; i < m2; i++) {
+        const float *a = src + (size_t)(2 * i) * n, *b = a + n;
+        float *d = dst + (size_t)i * n2;
+        #pragma omp simd
+        for (int j = 0; j < n2; j++) {
+            float v0 = a[2 * j], v1 = a[2 * j + 1], v2 = b[2 * j], v3 = b[2 * j + 1];
+            v0 = v0 < 0.0f ? 0.0f : v0 > peak ? peak : v0;
+            v1 = v1 < 0.0f ? 0.0f : v1 > peak ? peak : v1;
+            v2 = v2 < 0.0f ? 0.0f : v2 > peak ? peak : v2;
+            v3 = v3 < 0.0f ? 0.0f : v3 > peak ? peak : v3;
+            d[j] = 0.25f * (v0 + v1 + v2 + v3);
+        }
+    }
+}
+
+int metrics_compute(const float *ref, const float *img, int m, int n, float peak, image_metrics *out) {
+    out->ssim = out->msssim = NAN;
+    double *rows = (double*)malloc((size_t)3 * m * sizeof(double));
+    if (!rows) return -1;
+    double *row_s = rows, *row_c = rows + m, *row_mse = rows + 2 * (size_t)m;
+    float w[SSIM_WIN];
+    gauss_window(w);
+
+    double ssim0 = NAN, cs[MS_SCALES];
+    if (m >= SSIM_WIN && n >= SSIM_WIN) {
+        if (ssim_scale(ref, img, m, n, peak, w, row_s, row_c, row_mse, &ssim0, &cs[0]) != 0) {
+            free(rows);
+            return -1;
+        }
+    } else {
+        // Too small for a window, only the error
+        for (int i = 0; i < m; i++) {
+            double e = 0.0;
+            for (int j = 0; j < n; j++) {
+                float a = ref[(size_t)i * n + j], b = img[(size_t)i * n + j];
+                a = a < 0.0f ? 0.0f : a > peak ? peak : a;
+                b = b < 0.0f ? 0.0f : b > peak ? peak : b;
+                e += (double)(a - b) * (a - b);
+            }
+            row_mse[i] = e;
+        }
+    }
+    double se = 0.0;
+    for (int i = 0; i < m; i++) se += row_mse[i];
+    out->mse = se / ((double)m * n);
+    out->psnr = out->mse > 0.0 ? 10.0 * log10((double)peak * peak / out->mse) : INFINITY;
+    out->ssim = ssim0;
+    if (isnan(ssim0)) {
+        free(rows);
+        return 0;
+    }
+
+    // Scales that still fit a window
+    int scales = 1, ms = m, ns = n;
+    while (scales < MS_SCALES && ms / 2 >= SSIM_WIN && ns / 2 >= SSIM_WIN) {
+        ms /= 2;
+        ns /= 2;
+        scales++;
+    }
+    double ssim_last = ssim0;
+    float *pyr = NULL;
+    if (scales > 1) {
+        // Level 1 and 3 share one pair of buffers, level 2 and 4 the other
+        size_t big = (size_t)(m / 2) * (n / 2), small = (size_t)(m / 4) * (n / 4);
+        pyr = (float*)malloc((2 * big + 2 * small) * sizeof(float));
+        if (!pyr) {
+            free(rows);
+            return -1;
+        }
+        float *bx[2] = { pyr, pyr + 2 * big }, *by[2] = { pyr + big, pyr + 2 * big + small };
+        const float *px = ref, *py = img;
+        int pm = m, pn = n;
+        for (int s = 1; s < scales; s++) {
+            float *dx = bx[(s - 1) & 1], *dy = by[(s - 1) & 1];
+            downsample(px, pm, pn, dx, peak);
+            downsample(py, pm, pn, dy, peak);
+            pm /= 2;
+            pn /= 2;
+            if (ssim_scale(dx, dy, pm, pn, peak, w, row_s, row_c, NULL, &ssim_last, &cs[s]) != 0) {
+                free(pyr);
+                free(rows);
+                return -1;
+            }
+            px = dx;
+            py = dy;
+        }
+    }
+    double wsum = 0.0, ms_ssim = 1.0;
+    for (int s = 0; s < scales; s++) wsum += ms_weight[s];
+    for (int s = 0; s < scales; s++) {
+        double v = s == scales - 1 ? ssim_last : cs[s];
+        ms_ssim *= pow(v > 0.0 ? v : 0.0, ms_weight[s] / wsum);
+    }
+    out->msssim = ms_ssim;
+    free(pyr);
+    free(rows);
+    return 0;
+}
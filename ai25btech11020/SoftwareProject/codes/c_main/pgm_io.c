@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "..\c_libs\pgm_io.h"
+#include "../c_libs/pgm_io.h"
 
 float* read_pgm(const char *path, int *rows, int *cols){
     FILE *f = fopen(path, "rb");
@@ -43,3 +43,37 @@ void write_pgm(const char *path, const float *buf, int rows, int cols){
     fclose(f);
     free(buf8);
 }
+
+
+/* Streaming reader: opens the file and reads only the header,
+   then rows are pulled in batches with pgm_stream_read_rows */
+FILE* pgm_stream_open(const char *path, int *rows, int *cols){
+    FILE *f = fopen(path, "rb");
+    if(!f){ fprintf(stderr,"Cannot open %s\n", path); return NULL; }
+
+    char magic[3];
+    int w,h,maxv;
+    if(fscanf(f, "%2s", magic) != 1 || strcmp(magic, "P5") != 0 ||
+       fscanf(f, "%d %d %d", &w, &h, &maxv) != 3){
+        fprintf(stderr,"%s is not a binary PGM (P5)\n", path);
+        fclose(f); return NULL;
+    }
+    fgetc(f);
+
+    *rows=h; *cols=w;
+    return f;
+}
+
+/* Reads up to count rows into buf (count×cols floats), returns rows read */
+int pgm_stream_read_rows(FILE *f, float *buf, int count, int cols){
+    unsigned char *buf8 = (unsigned char*)malloc((size_t)cols);
+    if(!buf8) return 0;
+    int got=0;
+    while(got<count && fread(buf8,1,(size_t)cols,f)==(size_t)cols){
+        float *row = buf + (size_t)got*cols;
+        for(int j=0;j<cols;j++) row[j]=(float)buf8[j];
+        got++;
+    }
+    free(buf8);
+    return got;
+}
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../c_libs/threads.h"
+#include "../c_libs/png_fast.h"
+
+/*Bit writer*/
+
+typedef struct {
+    unsigned char *buf;
+    size_t len, cap;
+    unsigned int bits;  // pending bits, lowest first
+    int count;
+    int failed;
+} bit_out;
+
+static void put_byte(bit_out *o, unsigned char c) {
+    if (o->len == o->cap) {
+        size_t nc = o->cap ? 2 * o->cap : 4096;
+        unsigned char *p = (unsigned char*)realloc(o->buf, nc);
+        if (!p) { o->failed = 1; return; }
+        o->buf = p;
+        o->cap = nc;
+    }
+    o->buf[o->len++] = c;
+}
+
+static void put_bits(bit_out *o, unsigned int value, int nbits) {
+    o->bits |= value << o->count;
+    o->count += nbits;
+    while (o->count >= 8) {
+        put_byte(o, (unsigned char)o->bits);
+        o->bits >>= 8;
+        o->count -= 8;
+    }
+}
+
+static void align_byte(bit_out *o) {
+    if (o->count > 0) put_bits(o, 0, 8 - o->count);
+}
+
+// Huffman codes go out highest bit first, so they are written reversed
+static void put_code(bit_out *o, unsigned int code, int nbits) {
+    unsigned int r = 0;
+    for (int i = 0; i < nbits; ++i) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    put_bits(o, r, nbits);
+}
+
+/*Deflate, fixed Huffman codes*/
+
+static const unsigned short len_base[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258,259 };
+static const unsigned char  len_extra[] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const unsigned short dist_base[] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,32769 };
+static const unsigned char  dist_extra[] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+static void put_literal(bit_out *o, int c) {
+    if (c <= 143)      put_code(o, 0x30 + c, 8);
+    else if (c <= 255) put_code(o, 0x190 + c - 144, 9);
+    else if (c <= 279) put_code(o, c - 256, 7);
+    else               put_code(o, 0xc0 + c - 280, 8);
+}
+
+static void put_match(bit_out *o, int len, int dist) {
+    int j = 0;
+    while (len >= len_base[j + 1]) j++;
+    put_literal(o, 257 + j);
+    if (len_extra[j]) put_bits(o, len - len_base[j], len_extra[j]);
+    j = 0;
+    while (dist >= dist_base[j + 1]) j++;
+    put_code(o, j, 5);
+    if (dist_extra[j]) put_bits(o, dist - dist_base[j], dist_extra[j]);
+}
+
+#define HASH_BITS 15
+#define WINDOW 32768
+#define MAX_MATCH 258
+
+static unsigned int hash3(const unsigned char *p) {
+    unsigned int h = (unsigned int)p[0] << 16 | (unsigned int)p[1] << 8 | p[2];
+    return (h * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Compresses data[start..end) as one fixed Huffman block. Matches may
+   reach back into the 32K before start (dict), which the decoder already
+   has from the earlier band, as in pigz. The block is not final and is
+   followed by an empty stored block, which ends the band on a byte. */
+static void deflate_band(bit_out *o, const unsigned char *data, size_t dict, size_t start, size_t end, int level) {
+    if (level <= 0) {
+        // Stored blocks of at most 65535 bytes
+        for (size_t p = start; p < end;) {
+            size_t len = end - p < 65535 ? end - p : 65535;
+            put_bits(o, 0, 3);
+            align_byte(o);
+            put_byte(o, (unsigned char)len); put_byte(o, (unsigned char)(len >> 8));
+            put_byte(o, (unsigned char)~len); put_byte(o, (unsigned char)(~len >> 8));
+            for (size_t i = 0; i < len; ++i) put_byte(o, data[p + i]);
+            p += len;
+        }
+    } else {
+        int chain = 2 << level;   // how many earlier places to try, 4 .. 1024
+        size_t base = dict, span = end - base;
+        int *head = (int*)malloc(((size_t)1 << HASH_BITS) * sizeof(int));
+        int *prev = (int*)malloc((span ? span : 1) * sizeof(int));
+        if (!head || !prev) {
+            free(head); free(prev);
+            o->failed = 1;
+            return;
+        }
+        for (size_t i = 0; i < ((size_t)1 << HASH_BITS); ++i) head[i] = -1;
+
+        // Position i (relative to base) goes into the hash chains
+        #define INSERT(i) do { unsigned int h_ = hash3(data + base + (i)); \
+                               prev[i] = head[h_]; head[h_] = (int)(i); } while (0)
+        for (size_t i = 0; i + 3 <= start - base && base + i + 3 <= end; ++i)
+            INSERT(i);
+
+        put_bits(o, 0, 1);   // BFINAL = 0
+        put_bits(o, 1, 2);   // BTYPE = 1, fixed Huffman
+        size_t i = start - base;
+        while (base + i < end) {
+            int best = 0, best_dist = 0;
+            if (base + i + 3 <= end) {
+                size_t limit = end - base - i < MAX_MATCH ? end - base - i : MAX_MATCH;
+                const unsigned char *cur = data + base + i;
+                int tries = chain;
+                for (int c = head[hash3(cur)]; c >= 0 && tries-- > 0; c = prev[c]) {
+                    size_t dist = i - (size_t)c;
+                    if (dist > WINDOW - 1) break;
+                    const unsigned char *cand = data + base + c;
+                    if (cand[best] != cur[best]) continue;
+                    size_t l = 0;
+                    while (l < limit && cand[l] == cur[l]) l++;
+                    if ((int)l > best) {
+                        best = (int)l;
+                        best_dist = (int)dist;
+                        if (l == limit) break;
+                    }
+                }
+                INSERT(i);
+            }
+            if (best >= 3) {
+                put_match(o, best, best_dist);
+                for (int s = 1; s < best; ++s)
+                    if (base + i + s + 3 <= end) INSERT(i + s);
+                i += best;
+            } else {
+                put_literal(o, data[base + i]);
+                i++;
+            }
+        }
+        #undef INSERT
+        put_literal(o, 256);   // end of block
+        free(head);
+        free(prev);
+    }
+    // Empty stored block: byte aligns the band so the next one can be appended
+    put_bits(o, 0, 3);
+    align_byte(o);
+    put_byte(o, 0); put_byte(o, 0); put_byte(o, 0xff); put_byte(o, 0xff);
+}
+
+/*Checksums*/
+
+static unsigned int adler32(const unsigned char *p, size_t len) {
+    unsigned long long a = 1, b = 0;
+    while (len > 0) {
+        size_t run = len < 5552 ? len : 5552;
+        for (size_t i = 0; i < run; ++i) { a += p[i]; b += a; }
+        a %= 65521; b %= 65521;
+        p += run; len -= run;
+    }
+    return (unsigned int)(b << 16 | a);
+}
+
+/* Adler-32 of two pieces joined, from their own checksums (as zlib's adler32_combine) */
+static unsigned int adler32_combine(unsigned int a1, unsigned int a2, size_t len2) {
+    const unsigned long long base = 65521;
+    unsigned long long rem = len2 % base;
+    unsigned long long s1 = a1 & 0xffff, s2 = (rem * s1) % base;
+    s1 += (a2 & 0xffff) + base - 1;
+    s2 += (a1 >> 16) + (a2 >> 16) + base - rem;
+    s1 %= base;
+    s2 %= base;
+    return (unsigned int)(s2 << 16 | s1);
+}
+
+static unsigned int crc_table[256];
+
+static void make_crc_table(void) {
+    for (unsigned int n = 0; n < 256; ++n) {
+        unsigned int c = n;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static unsigned int crc32(unsigned int crc, const unsigned char *p, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/*Filtering*/
+
+static int paeth(int a, int b, int c) {
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+/* Filters row y of the 8 bit image into out (filter byte + cols bytes),
+   picking the filter with the smallest sum of |values| like stb does */
+static void filter_row(const unsigned char *img, int y, int cols, unsigned char *out, unsigned char *trial) {
+    const unsigned char *z = img + (size_t)y * cols;
+    const unsigned char *up = y > 0 ? z - cols : NULL;
+    int best_type = 0;
+    long best_sum = -1;
+    for (int type = 0; type < 5; ++type) {
+        if (!up && (type == 2 || type == 4)) continue;   // same as 0 and 1 on the first row
+        long sum = 0;
+        for (int i = 0; i < cols; ++i) {
+            int a = i > 0 ? z[i - 1] : 0, b = up ? up[i] : 0, c = (up && i > 0) ? up[i - 1] : 0, v;
+            switch (type) {
+                case 0: v = z[i]; break;
+                case 1: v = z[i] - a; break;
+                case 2: v = z[i] - b; break;
+                case 3: v = z[i] - ((a + b) >> 1); break;
+                default: v = z[i] - paeth(a, b, c); break;
+            }
+            trial[i] = (unsigned char)v;
+            sum += abs((signed char)v);
+        }
+        if (best_sum < 0 || sum < best_sum) {
+            best_sum = sum;
+            best_type = type;
+            memcpy(out + 1, trial, (size_t)cols);
+        }
+    }
+    out[0] = (unsigned char)best_type;
+}
+
+/*PNG file*/
+
+static void put32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 24); p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);  p[3] = (unsigned char)v;
+}
+
+unsigned char* png_fast_encode(const float *buf, int rows, int cols, int level, size_t *out_len) {
+    size_t line = (size_t)cols + 1, count = (size_t)rows * cols;
+    unsigned char *img = (unsigned char*)malloc(count);
+    unsigned char *filt = (unsigned char*)malloc((size_t)rows * line);
+    if (!img || !filt || rows < 1 || cols < 1) {
+        free(img); free(filt);
+        return NULL;
+    }
+    if (level > 9) level = 9;
+
+    // Bands of at least 32 rows, a few per thread so slow bands even out
+    int nb = threads_count() * 4;
+    if (nb > rows / 32) nb = rows / 32;
+    if (nb < 1) nb = 1;
+    bit_out *parts = (bit_out*)calloc((size_t)nb, sizeof(bit_out));
+    unsigned int *sums = (unsigned int*)malloc((size_t)nb * sizeof(unsigned int));
+    if (!parts || !sums) {
+        free(img); free(filt); free(parts); free(sums);
+        return NULL;
+    }
+
+    // Same rounding as write_pgm
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x) {
+            float v = buf[(size_t)y * cols + x];
+            if (v < 0) v = 0;
+            if (v > 255) v = 255;
+            img[(size_t)y * cols + x] = (unsigned char)(v + 0.5f);
+        }
+
+    // Filtering only looks at the 8 bit rows, so every row can go first
+    #pragma omp parallel
+    {
+        unsigned char *trial = (unsigned char*)malloc((size_t)cols);
+        #pragma omp for schedule(static)
+        for (int y = 0; y < rows; ++y) {
+            if (trial) filter_row(img, y, cols, filt + (size_t)y * line, trial);
+            else parts[0].failed = 1;
+        }
+        free(trial);
+    }
+
+    // Then every band is deflated on its own, with the 32K before it as dictionary
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nb; ++b) {
+        size_t start = (size_t)rows * b / nb * line, end = (size_t)rows * (b + 1) / nb * line;
+        size_t dict = start > WINDOW ? start - WINDOW : 0;
+        deflate_band(&parts[b], filt, dict, start, end, level);
+        sums[b] = adler32(filt + start, end - start);
+    }
+
+    // zlib header, the bands, a final empty block and the Adler-32 of everything
+    size_t zlen = 2 + 2 + 4;
+    int failed = 0;
+    unsigned int adler = 1;
+    for (int b = 0; b < nb; ++b) {
+        zlen += parts[b].len;
+        failed |= parts[b].failed;
+        size_t start = (size_t)rows * b / nb * line, end = (size_t)rows * (b + 1) / nb * line;
+        adler = b == 0 ? sums[0] : adler32_combine(adler, sums[b], end - start);
+    }
+
+    size_t total = 8 + (12 + 13) + (12 + zlen) + 12;
+    unsigned char *png = failed ? NULL : (unsigned char*)malloc(total);
+    if (png) {
+        static const unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        #pragma omp critical(png_fast_crc)
+        if (!crc_table[1]) make_crc_table();
+        unsigned char *o = png;
+        memcpy(o, sig, 8); o += 8;
+
+        put32(o, 13); memcpy(o + 4, "IHDR", 4);
+        put32(o + 8, (unsigned int)cols);
+        put32(o + 12, (unsigned int)rows);
+        o[16] = 8; o[17] = 0; o[18] = 0; o[19] = 0; o[20] = 0;   // 8 bit gray, no interlace
+        put32(o + 21, crc32(0, o + 4, 17));
+        o += 25;
+
+        put32(o, (unsigned int)zlen); memcpy(o + 4, "IDAT", 4);
+        unsigned char *z = o + 8;
+        z[0] = 0x78;
+        z[1] = level <= 1 ? 0x01 : level <= 5 ? 0x5e : level <= 7 ? 0x9c : 0xda;
+        z += 2;
+        for (int b = 0; b < nb; ++b) {
+            memcpy(z, parts[b].buf, parts[b].len);
+            z += parts[b].len;
+        }
+        z[0] = 0x03; z[1] = 0x00;   // BFINAL = 1, fixed Huffman, end of block
+        put32(z + 2, adler);
+        put32(o + 8 + zlen, crc32(0, o + 4, zlen + 4));
+        o += 12 + zlen;
+
+        put32(o, 0); memcpy(o + 4, "IEND", 4);
+        put32(o + 8, crc32(0, o + 4, 4));
+        *out_len = total;
+    }
+
+    for (int b = 0; b < nb; ++b) free(parts[b].buf);
+    free(parts); free(sums); free(img); free(filt);
+    return png;
+}
+
+int write_png_fast(const char *path, const float *buf, int rows, int cols, int level) {
+    size_t len = 0;
+    unsigned char *png = png_fast_encode(buf, rows, cols, level, &len);
+    if (!png) {
+        fprintf(stderr, "Error: could not encode %s\n", path);
+        return -1;
+    }
+    FILE *f = fopen(path, "wb");
+    int bad = !f || fwrite(png, 1, len, f) != len;
+    if (f) fclose(f);
+    if (bad) fprintf(stderr, "Error: Cannot write %s\n", path);
+    free(png);
+    return bad ? -1 : 0;
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/shared_basis.h"
+
+/*Shared basis for a collection of images*/
+
+/* Standard normal numbers from a fixed seed (Box-Muller on xorshift),
+   so the same collection always gives the same basis */
+static void fill_gaussian(float *X, size_t count, unsigned int seed) {
+    unsigned int s = seed ? seed : 1u;
+    for (size_t i = 0; i < count; i += 2) {
+        double u[2];
+        for (int t = 0; t < 2; ++t) {
+            s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+            u[t] = ((s >> 8) + 0.5) / 16777216.0;
+        }
+        double r = sqrt(-2.0 * log(u[0]));
+        X[i] = (float)(r * cos(6.283185307179586 * u[1]));
+        if (i + 1 < count) X[i + 1] = (float)(r * sin(6.283185307179586 * u[1]));
+    }
+}
+
+int shared_basis_init(shared_basis *sb, int m, int n, int rank, int oversample, int left) {
+    memset(sb, 0, sizeof(*sb));
+    if (m <= 0 || n <= 0 || rank <= 0) return -1;
+    if (oversample < 0) oversample = 0;
+    int l = rank + oversample;
+    if (l > n) l = n;
+    if (left && l > m) l = m;
+    if (rank > l) rank = l;
+
+    sb->m = m; sb->n = n; sb->rank = rank; sb->left = left; sb->l = l;
+    sb->V = (float*)malloc((size_t)n * rank * sizeof(float));
+    sb->Om = (float*)malloc((size_t)n * l * sizeof(float));
+    sb->Zs = (double*)calloc((size_t)n * l, sizeof(double));
+    sb->Q = (float*)malloc((size_t)n * l * sizeof(float));
+    sb->B = (double*)calloc((size_t)l * l, sizeof(double));
+    sb->Tm = (float*)malloc((size_t)m * l * sizeof(float));
+    sb->Tn = (float*)malloc((size_t)n * l * sizeof(float));
+    int bad = !sb->V || !sb->Om || !sb->Zs || !sb->Q || !sb->B || !sb->Tm || !sb->Tn;
+    if (left) {
+        sb->U = (float*)malloc((size_t)m * rank * sizeof(float));
+        sb->Oml = (float*)malloc((size_t)m * l * sizeof(float));
+        sb->Zsl = (double*)calloc((size_t)m * l, sizeof(double));
+        sb->Ql = (float*)malloc((size_t)m * l * sizeof(float));
+        sb->Bl = (double*)calloc((size_t)l * l, sizeof(double));
+        sb->Tm2 = (float*)malloc((size_t)m * l * sizeof(float));
+        sb->Tn2 = (float*)malloc((size_t)n * l * sizeof(float));
+        bad = bad || !sb->U || !sb->Oml || !sb->Zsl || !sb->Ql || !sb->Bl || !sb->Tm2 || !sb->Tn2;
+    }
+    if (bad) {
+        shared_basis_free(sb);
+        return -1;
+    }
+    fill_gaussian(sb->Om, (size_t)n * l, 12345u);
+    if (left) fill_gaussian(sb->Oml, (size_t)m * l, 54321u);
+    return 0;
+}
+
+/* Pass 1: Zs += Aᵀ (A Om) and Zsl += A (Aᵀ Oml). The sums only grow
+   with the sizes, not with the number of images. */
+int shared_basis_add_image(shared_basis *sb, const float *A) {
+    if (sb->stage != 0) return -1;
+    int m = sb->m, n = sb->n, l = sb->l;
+
+    matmul_A_times_V(A, sb->Om, sb->Tm, m, n, l);
+    matmul_AT_times_Y(A, sb->Tm, sb->Tn, m, n, l);
+    for (size_t i = 0; i < (size_t)n * l; ++i) sb->Zs[i] += sb->Tn[i];
+
+    if (sb->left) {
+        matmul_AT_times_Y(A, sb->Oml, sb->Tn2, m, n, l);
+        matmul_A_times_V(A, sb->Tn2, sb->Tm2, m, n, l);
+        for (size_t i = 0; i < (size_t)m * l; ++i) sb->Zsl[i] += sb->Tm2[i];
+    }
+    sb->images++;
+    return 0;
+}
+
+/* Orthonormal bases of the sketches. After this the basis can be used
+   right away (finish) or improved with a second pass (refine_image).
+   The sketch columns span a squared spectrum, so one float Gram-Schmidt
+   leaves them visibly non orthogonal; a second sweep fixes that. */
+int shared_basis_end_sketch(shared_basis *sb) {
+    if (sb->stage != 0 || sb->images == 0) return -1;
+    int m = sb->m, n = sb->n, l = sb->l;
+    for (size_t i = 0; i < (size_t)n * l; ++i) sb->Q[i] = (float)sb->Zs[i];
+    qr_modified_gram_schmidt(sb->Q, n, l, l);
+    qr_modified_gram_schmidt(sb->Q, n, l, l);
+    if (sb->left) {
+        for (size_t i = 0; i < (size_t)m * l; ++i) sb->Ql[i] = (float)sb->Zsl[i];
+        qr_modified_gram_schmidt(sb->Ql, m, l, l);
+        qr_modified_gram_schmidt(sb->Ql, m, l, l);
+    }
+    sb->images = 0;
+    sb->stage = 1;
+    return 0;
+}
+
+/* Adds XᵀX to the l×l sum B (X is rows×l) */
+static void add_gram(double *B, const float *X, int rows, int l) {
+    for (int i = 0; i < rows; ++i) {
+        const float *x = X + (size_t)i * l;
+        for (int a = 0; a < l; ++a) {
+            double xa = x[a];
+            double *brow = B + (size_t)a * l;
+            for (int c = 0; c < l; ++c)
+                brow[c] += xa * x[c];
+        }
+    }
+}
+
+/* Pass 2 (Rayleigh-Ritz): B += (A Q)ᵀ (A Q), Bl += (Aᵀ Ql)ᵀ (Aᵀ Ql) */
+int shared_basis_refine_image(shared_basis *sb, const float *A) {
+    if (sb->stage != 1) return -1;
+    int m = sb->m, n = sb->n, l = sb->l;
+    matmul_A_times_V(A, sb->Q, sb->Tm, m, n, l);
+    add_gram(sb->B, sb->Tm, m, l);
+    if (sb->left) {
+        matmul_AT_times_Y(A, sb->Ql, sb->Tn, m, n, l);
+        add_gram(sb->Bl, sb->Tn, n, l);
+    }
+    sb->images++;
+    return 0;
+}
+
+/* Without the second pass B = Qᵀ M Q (M the sum of AᵀA) is estimated from
+   the sketch Zs = M Om alone (single pass Nystrom): M ~ Zs (Omᵀ Zs)⁻¹ Zsᵀ,
+   so B ~ G H⁻¹ Gᵀ with G = Qᵀ Zs and H = Omᵀ Zs. With H = L Lᵀ
+   (Cholesky) this is W Wᵀ for W = G L⁻ᵀ, which stays positive
+   semidefinite. H is only semidefinite in exact arithmetic, so a small
+   shift is added until the Cholesky goes through. */
+static int nystrom_gram(const float *Q, const double *Zs, const float *Om, int rows, int l, double *B) {
+    double *G = (double*)calloc((size_t)l * l, sizeof(double));
+    double *H = (double*)calloc((size_t)l * l, sizeof(double));
+    double *L = (double*)malloc((size_t)l * l * sizeof(double));
+    if (!G || !H || !L) {
+        free(G); free(H); free(L);
+        return -1;
+    }
+    for (int i = 0; i < rows; ++i) {
+        const float *q = Q + (size_t)i * l, *o = Om + (size_t)i * l;
+        const double *z = Zs + (size_t)i * l;
+        for (int a = 0; a < l; ++a) {
+            double qa = q[a], oa = o[a];
+            for (int c = 0; c < l; ++c) {
+                G[(size_t)a * l + c] += qa * z[c];
+                H[(size_t)a * l + c] += oa * z[c];
+            }
+        }
+    }
+    double trace = 0.0;
+    for (int a = 0; a < l; ++a) {
+        trace += H[(size_t)a * l + a];
+        for (int c = 0; c < a; ++c) {
+            double h = 0.5 * (H[(size_t)a * l + c] + H[(size_t)c * l + a]);
+            H[(size_t)a * l + c] = H[(size_t)c * l + a] = h;
+        }
+    }
+
+    // Cholesky H + shift I = L Lᵀ (L lower triangular)
+    int ok = 0;
+    for (double shift = 1e-12 * trace; !ok && shift <= 1e-2 * trace; shift *= 100.0) {
+        ok = 1;
+        for (int j = 0; j < l && ok; ++j) {
+            for (int i = j; i < l; ++i) {
+                double sum = H[(size_t)i * l + j] + (i == j ? shift : 0.0);
+                for (int t = 0; t < j; ++t)
+                    sum -= L[(size_t)i * l + t] * L[(size_t)j * l + t];
+                if (i == j) {
+                    if (sum <= 0.0) { ok = 0; break; }
+                    L[(size_t)j * l + j] = sqrt(sum);
+                } else {
+                    L[(size_t)i * l + j] = sum / L[(size_t)j * l + j];
+                }
+            }
+        }
+    }
+    if (!ok) {
+        free(G); free(H); free(L);
+        return -1;
+    }
+
+    // Rows of W: solve L w = g for every row g of G (W overwrites G)
+    for (int a = 0; a < l; ++a) {
+        double *g = G + (size_t)a * l;
+        for (int j = 0; j < l; ++j) {
+            double sum = g[j];
+            for (int t = 0; t < j; ++t)
+                sum -= L[(size_t)j * l + t] * g[t];
+            g[j] = sum / L[(size_t)j * l + j];
+        }
+    }
+    for (int a = 0; a < l; ++a)
+        for (int c = 0; c < l; ++c) {
+            double sum = 0.0;
+            for (int t = 0; t < l; ++t)
+                sum += G[(size_t)a * l + t] * G[(size_t)c * l + t];
+            B[(size_t)a * l + c] = sum;
+        }
+    free(G); free(H); free(L);
+    return 0;
+}
+
+/* basis = Q E, E the top rank eigenvectors of B (Jacobi SVD of a
+   symmetric PSD matrix) */
+static int ritz_basis(const float *Q, const double *B, int rows, int l, int rank, float *out) {
+    float *Bf = (float*)malloc((size_t)l * l * sizeof(float));
+    float *E = (float*)malloc((size_t)l * l * sizeof(float));
+    float *Ev = (float*)malloc((size_t)l * l * sizeof(float));
+    float *S = (float*)malloc((size_t)l * sizeof(float));
+    float *Er = (float*)malloc((size_t)l * rank * sizeof(float));
+    if (!Bf || !E || !Ev || !S || !Er) {
+        free(Bf); free(E); free(Ev); free(S); free(Er);
+        return -1;
+    }
+    for (size_t i = 0; i < (size_t)l * l; ++i) Bf[i] = (float)B[i];
+    small_svd_jacobi(Bf, l, l, E, S, Ev);
+    for (int i = 0; i < l; ++i)
+        memcpy(Er + (size_t)i * rank, E + (size_t)i * l, (size_t)rank * sizeof(float));
+    matmul_A_times_V(Q, Er, out, rows, l, rank);
+    free(Bf); free(E); free(Ev); free(S); free(Er);
+    return 0;
+}
+
+int shared_basis_finish(shared_basis *sb) {
+    if (sb->stage == 0 && shared_basis_end_sketch(sb) != 0) return -1;
+    if (sb->stage != 1) return -1;
+    // No refine pass: B comes from the sketch instead
+    if (sb->images == 0) {
+        if (nystrom_gram(sb->Q, sb->Zs, sb->Om, sb->n, sb->l, sb->B) != 0) return -1;
+        if (sb->left && nystrom_gram(sb->Ql, sb->Zsl, sb->Oml, sb->m, sb->l, sb->Bl) != 0) return -1;
+    }
+    if (ritz_basis(sb->Q, sb->B, sb->n, sb->l, sb->rank, sb->V) != 0) return -1;
+    if (sb->left && ritz_basis(sb->Ql, sb->Bl, sb->m, sb->l, sb->rank, sb->U) != 0) return -1;
+    sb->stage = 2;
+    return 0;
+}
+
+/*Per image coefficients*/
+
+int shared_basis_coef_rows(const shared_basis *sb) {
+    return sb->left ? sb->rank : sb->m;
+}
+
+/* coef = A V, or Uᵀ A V with a left basis */
+int shared_basis_encode(const shared_basis *sb, const float *A, float *coef) {
+    int m = sb->m, n = sb->n, r = sb->rank;
+    if (!sb->left) {
+        matmul_A_times_V(A, sb->V, coef, m, n, r);
+        return 0;
+    }
+    float *T = (float*)malloc((size_t)m * r * sizeof(float));
+    if (!T) return -1;
+    matmul_A_times_V(A, sb->V, T, m, n, r);
+    matmul_AT_times_Y(sb->U, T, coef, m, r, r);
+    free(T);
+    return 0;
+}
+
+/* A_out = coef Vᵀ, or U coef Vᵀ with a left basis */
+int shared_basis_decode(const shared_basis *sb, const float *coef, float *A_out) {
+    int m = sb->m, n = sb->n, r = sb->rank;
+    memset(A_out, 0, (size_t)m * n * sizeof(float));
+    // r×n scratch for rank_update, then m×r for U coef
+    float *work = (float*)malloc(((size_t)r * n + (sb->left ? (size_t)m * r : 0)) * sizeof(float));
+    if (!work) return -1;
+    if (!sb->left) {
+        rank_update(A_out, NULL, m, n, coef, NULL, sb->V, r, work);
+        free(work);
+        return 0;
+    }
+    float *T = work + (size_t)r * n;
+    matmul_A_times_V(sb->U, coef, T, m, r, r);
+    rank_update(A_out, NULL, m, n, T, NULL, sb->V, r, work);
+    free(work);
+    return 0;
+}
+
+/*Basis file*/
+
+int shared_basis_save(const char *path, const shared_basis *sb) {
+    if (sb->stage != 2) return -1;
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+    int head[4] = { sb->m, sb->n, sb->rank, sb->left };
+    size_t nv = (size_t)sb->n * sb->rank, nu = (size_t)sb->m * sb->rank;
+    int bad = fwrite("SVDB", 1, 4, fp) != 4 ||
+              fwrite(head, sizeof(int), 4, fp) != 4 ||
+              fwrite(sb->V, sizeof(float), nv, fp) != nv ||
+              (sb->left && fwrite(sb->U, sizeof(float), nu, fp) != nu);
+    fclose(fp);
+    return bad ? -1 : 0;
+}
+
+/* Loads a finished basis, only V and U are allocated */
+int shared_basis_load(const char *path, shared_basis *sb) {
+    memset(sb, 0, sizeof(*sb));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    char magic[4];
+    int head[4];
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, "SVDB", 4) != 0 ||
+        fread(head, sizeof(int), 4, fp) != 4 || head[0] <= 0 || head[1] <= 0 || head[2] <= 0) {
+        fprintf(stderr, "%s is not a basis file (.svdb)\n", path);
+        fclose(fp);
+        return -1;
+    }
+    sb->m = head[0]; sb->n = head[1]; sb->rank = head[2]; sb->left = head[3] != 0;
+    sb->l = sb->rank;
+    sb->stage = 2;
+    size_t nv = (size_t)sb->n * sb->rank, nu = (size_t)sb->m * sb->rank;
+    sb->V = (float*)malloc(nv * sizeof(float));
+    if (sb->left) sb->U = (float*)malloc(nu * sizeof(float));
+    int bad = !sb->V || (sb->left && !sb->U) ||
+              fread(sb->V, sizeof(float), nv, fp) != nv ||
+              (sb->left && fread(sb->U, sizeof(float), nu, fp) != nu);
+    fclose(fp);
+    if (bad) {
+        fprintf(stderr, "%s is cut short\n", path);
+        shared_basis_free(sb);
+        return -1;
+    }
+    return 0;
+}
+
+void shared_basis_free(shared_basis *sb) {
+    free(sb->V); free(sb->U);
+    free(sb->Om); free(sb->Oml); free(sb->Zs); free(sb->Zsl);
+    free(sb->Q); free(sb->Ql); free(sb->B); free(sb->Bl);
+    free(sb->Tm); free(sb->Tn); free(sb->Tm2); free(sb->Tn2);
+    memset(sb, 0, sizeof(*sb));
+}
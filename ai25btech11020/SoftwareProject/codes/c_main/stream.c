@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/svd_factors.h"
+#include "../c_libs/svd_stream.h"
+#include "../c_libs/synth.h"
+
+/* Runs the streaming SVD (svd_stream.h).
+
+   ./stream in.pgm max_rank out.pgm [--batch p]
+        reads the image p rows at a time (default 8), writes the rank
+        max_rank result and prints the error and the time
+   ./stream check m n r max_rank [--batch p] [--noise e] [--seed x]
+        streams an m×n matrix of exact rank r (gen_matrix rankdef profile,
+        no 8 bit rounding) and checks the factors: how far VᵀV and UᵀU are
+        from I, the singular values against the truth and the error.
+        r < max_rank is the rank deficient case, the extra values should
+        come out as nothing (or the noise) */
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 100·||A - U S Vᵀ|| / ||A|| */
+static double stream_error(const svd_stream *s, const float *A, float *A_out) {
+    size_t count = (size_t)s->rows * s->n;
+    svd_stream_reconstruct(s, A_out);
+    double diff = 0.0, norm = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double d = (double)A[i] - A_out[i];
+        diff += d * d;
+        norm += (double)A[i] * A[i];
+    }
+    return norm > 0.0 ? 100.0 * sqrt(diff / norm) : 0.0;
+}
+
+/* max |QᵀQ - I| of the first r columns of Q (rows×r, leading dimension ld) */
+static double max_off_identity(const float *Q, int rows, int r, int ld) {
+    double worst = 0.0;
+    for (int a = 0; a < r; a++)
+        for (int b = a; b < r; b++) {
+            double dot = 0.0;
+            for (int i = 0; i < rows; i++) dot += (double)Q[(size_t)i * ld + a] * Q[(size_t)i * ld + b];
+            double e = fabs(dot - (a == b ? 1.0 : 0.0));
+            if (e > worst) worst = e;
+        }
+    return worst;
+}
+
+static int compress(int argc, char **argv) {
+    int max_rank = atoi(argv[2]), batch = 8;
+    for (int a = 4; a < argc; a++)
+        if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) batch = atoi(argv[++a]);
+    if (batch < 1) batch = 1;
+
+    int m, n;
+    FILE *fp = pgm_stream_open(argv[1], &m, &n);
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot read %s\n", argv[1]);
+        return 1;
+    }
+    svd_stream s;
+    float *A = (float*)malloc((size_t)m * n * sizeof(float));
+    float *A_out = (float*)malloc((size_t)m * n * sizeof(float));
+    if (!A || !A_out || svd_stream_init(&s, n, max_rank) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        fclose(fp);
+        free(A); free(A_out);
+        return 1;
+    }
+    double t0 = seconds();
+    int ok = 1;
+    for (int row = 0; ok && row < m; row += batch) {
+        int count = m - row < batch ? m - row : batch;
+        float *rows = A + (size_t)row * n;
+        ok = pgm_stream_read_rows(fp, rows, count, n) == count && svd_stream_push_rows(&s, rows, count) == 0;
+    }
+    fclose(fp);
+    svd_stream_finalize(&s);
+    double t = seconds() - t0;
+    if (!ok) {
+        fprintf(stderr, "Error: streaming %s failed\n", argv[1]);
+    } else {
+        printf("%dx%d in batches of %d rows, rank %d: %.3f s, percentage error %.4f%%\n",
+               m, n, batch, s.rank, t, stream_error(&s, A, A_out));
+        write_pgm(argv[3], A_out, m, n);
+        printf("Saved %s\n", argv[3]);
+    }
+    svd_stream_free(&s);
+    free(A); free(A_out);
+    return ok ? 0 : 1;
+}
+
+static int check(int argc, char **argv) {
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s check m n r max_rank [--batch p] [--noise e] [--seed x]\n", argv[0]);
+        return 1;
+    }
+    int m = atoi(argv[2]), n = atoi(argv[3]), max_rank = atoi(argv[5]), batch = 7;
+    synth_params p;
+    synth_default_params(&p);
+    p.profile = SYNTH_RANKDEF;
+    p.rank = atoi(argv[4]);
+    for (int a = 6; a < argc; a++) {
+        if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) batch = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--noise") == 0 && a + 1 < argc) p.noise = atof(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) p.seed = strtoull(argv[++a], NULL, 10);
+    }
+    if (m < 1 || n < 1 || p.rank < 1 || p.rank > m || p.rank > n || max_rank < 1 || batch < 1) {
+        fprintf(stderr, "Error: need m, n, r, max_rank > 0 and r <= m, n\n");
+        return 1;
+    }
+
+    svd_factors truth;
+    svd_stream s;
+    float *A = (float*)malloc((size_t)m * n * sizeof(float));
+    float *A_out = (float*)malloc((size_t)m * n * sizeof(float));
+    if (!A || !A_out || synth_generate(&p, m, n, A, &truth) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        free(A); free(A_out);
+        return 1;
+    }
+    if (svd_stream_init(&s, n, max_rank) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        svd_factors_free(&truth);
+        free(A); free(A_out);
+        return 1;
+    }
+    int ok = 1;
+    for (int row = 0; ok && row < m; row += batch) {
+        int count = m - row < batch ? m - row : batch;
+        ok = svd_stream_push_rows(&s, A + (size_t)row * n, count) == 0;
+    }
+    svd_stream_finalize(&s);
+    if (!ok) {
+        fprintf(stderr, "Error: svd_stream_push_rows failed\n");
+    } else {
+        printf("%dx%d of rank %d%s, max_rank %d, batches of %d rows: rank %d kept\n",
+               m, n, p.rank, p.noise > 0.0 ? " plus noise" : "", max_rank, batch, s.rank);
+        printf("   i      sigma true     sigma found\n");
+        for (int i = 0; i < s.rank || i < truth.k; i++) {
+            if (i >= max_rank) break;
+            printf("%4d  %14.6g  %14.6g\n", i, i < truth.k ? truth.S[i] : 0.0f, i < s.rank ? s.S[i] : 0.0f);
+        }
+        int best_k = max_rank < truth.k ? max_rank : truth.k;
+        printf("max |VᵀV - I| %.2e, max |UᵀU - I| %.2e\n",
+               max_off_identity(s.V, n, s.rank, s.rank), max_off_identity(s.U, m, s.rank, s.max_rank));
+        printf("percentage error %.6f%% (best possible %.6f%%%s)\n", stream_error(&s, A, A_out),
+               synth_best_error(&truth, best_k), p.noise > 0.0 ? " before noise" : "");
+    }
+    svd_stream_free(&s);
+    svd_factors_free(&truth);
+    free(A); free(A_out);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "check") == 0) return check(argc, argv);
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s in.pgm max_rank out.pgm [--batch p]\n"
+                        "       %s check m n r max_rank [--batch p] [--noise e] [--seed x]\n", argv[0], argv[0]);
+        return 1;
+    }
+    return compress(argc, argv);
+}
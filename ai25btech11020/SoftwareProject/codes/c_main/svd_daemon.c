@@ -0,0 +1,795 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svdimg.h"
+#include "../c_libs/svd_daemon.h"
+
+/* Server mode: one long running process that keeps its threads,
+   workspaces and tuning profile warm and answers requests over a Unix
+   domain socket, so small images do not pay for process start up,
+   thread creation and first touch every time.
+
+   ./svd_daemon serve /tmp/svd.sock [--workers 2] [--threads 8] [--queue 64]
+                [--batch 8] [--profile tune_profile.txt] [--warm m n k] [--repro]
+   ./svd_daemon send  /tmp/svd.sock in.pgm k out.pgm [--error 5] [--factors] [--shm]
+   ./svd_daemon stats /tmp/svd.sock
+   ./svd_daemon bench /tmp/svd.sock in.pgm k count [clients]
+
+   Requests wait in a bounded queue; when it is full the server answers
+   SVDD_BUSY at once instead of letting the backlog grow (back-pressure).
+   The accept thread only takes a slot and queues the connection, a worker
+   reads the request under one deadline for the whole request. A worker takes up to --batch small images at a time and runs them side
+   by side, one context and one thread each; big images get all of the
+   worker's threads. */
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "../c_libs/threads.h"
+#include "../c_libs/tune_profile.h"
+#include "../c_libs/ingest.h"
+#include "../c_libs/pgm_io.h"
+
+#define SVDD_MAX_SIDE 65536
+#define SVDD_MAX_PIXELS ((size_t)1 << 28)
+#define SVDD_SMALL (256 * 256)   // images up to this size are batched
+#define SVDD_LAT_RING 4096       // latencies kept for the percentiles
+#define SVDD_READ_SECONDS 10.0   // to read a whole request, from accept
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = (char*)buf;
+    while (len > 0) {
+        ssize_t got = read(fd, p, len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        p += got;
+        len -= (size_t)got;
+    }
+    return 0;
+}
+
+/* read_full with one deadline for all of len, so a client that sends a
+   byte at a time cannot keep a worker for longer than that */
+static int read_until(int fd, void *buf, size_t len, double deadline) {
+    char *p = (char*)buf;
+    while (len > 0) {
+        int ms = (int)((deadline - now_sec()) * 1e3);
+        if (ms <= 0) return -1;
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, ms);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return -1;
+        ssize_t got = read(fd, p, len);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (got <= 0) return -1;
+        p += got;
+        len -= (size_t)got;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char*)buf;
+    while (len > 0) {
+        ssize_t put = write(fd, p, len);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return -1;
+        p += put;
+        len -= (size_t)put;
+    }
+    return 0;
+}
+
+/* Grows a reusable buffer, the pool slots keep theirs between requests */
+static void* grow(void **buf, size_t *cap, size_t bytes) {
+    if (bytes <= *cap) return *buf;
+    void *p = realloc(*buf, bytes);
+    if (!p) return NULL;
+    *buf = p;
+    *cap = bytes;
+    return p;
+}
+
+static int connect_to(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*Server*/
+
+typedef struct {
+    int fd;
+    int loaded;             // req and pixels have been read
+    svdd_request req;
+    double t_start;
+    unsigned char *pix;     // request pixels, points into the shm map when shm is used
+    void *pix_buf; size_t pix_cap;
+    void *out_buf; size_t out_cap;
+    void *f_buf; size_t f_cap;     // float copy of the pixels for OP_FACTORS
+    void *shm_base; size_t shm_size;
+} svdd_slot;
+
+typedef struct {
+    svdd_slot *slots;
+    int cap;
+    int *free_list, num_free;
+    int *ready, head, count;       // ring of slot indices waiting for a worker
+    int batch, threads_per_worker;
+    int warm_m, warm_n, warm_k;    // expected request size, 0 = none
+    int reproducible;              // same bits whatever the batching and threads
+    int quit;
+    tune_profile profile;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    // counters, under stat_lock
+    pthread_mutex_t stat_lock;
+    unsigned long long served, rejected, bad, batches, batched_jobs;
+    double lat[SVDD_LAT_RING];
+    int lat_count;
+} svdd_server;
+
+static volatile sig_atomic_t stop_flag = 0;
+static void on_signal(int sig) { (void)sig; stop_flag = 1; }
+
+static int by_value(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void format_stats(svdd_server *s, char *text, size_t size) {
+    static _Thread_local double sorted[SVDD_LAT_RING];   // workers answer stats too
+    pthread_mutex_lock(&s->stat_lock);
+    int nl = s->lat_count < SVDD_LAT_RING ? s->lat_count : SVDD_LAT_RING;
+    memcpy(sorted, s->lat, (size_t)nl * sizeof(double));
+    unsigned long long served = s->served, rejected = s->rejected, bad = s->bad;
+    double per_batch = s->batches ? (double)s->batched_jobs / s->batches : 0.0;
+    pthread_mutex_unlock(&s->stat_lock);
+    pthread_mutex_lock(&s->lock);
+    int queued = s->count;
+    pthread_mutex_unlock(&s->lock);
+
+    qsort(sorted, (size_t)nl, sizeof(double), by_value);
+    double p50 = nl ? sorted[(nl - 1) * 50 / 100] : 0.0;
+    double p95 = nl ? sorted[(nl - 1) * 95 / 100] : 0.0;
+    double p99 = nl ? sorted[(nl - 1) * 99 / 100] : 0.0;
+    snprintf(text, size,
+             "served %llu  rejected (busy) %llu  bad %llu  queued %d of %d\n"
+             "jobs per batch %.2f\n"
+             "latency over the last %d requests: p50 %.3f ms  p95 %.3f ms  p99 %.3f ms\n",
+             served, rejected, bad, queued, s->cap, per_batch, nl, 1e3 * p50, 1e3 * p95, 1e3 * p99);
+}
+
+static void send_reply(int fd, int status, int rank, float error, const void *payload, size_t bytes) {
+    svdd_reply r;
+    memcpy(r.magic, "SVDR", 4);
+    r.status = status;
+    r.rank = rank;
+    r.error = error;
+    r.bytes = bytes;
+    if (write_full(fd, &r, sizeof(r)) == 0 && bytes > 0)
+        write_full(fd, payload, bytes);
+}
+
+/* Runs one request with the given context and answers it */
+static void run_slot(svdd_server *s, svdd_slot *sl, svdimg_ctx *ctx, int threads) {
+    const svdd_request *q = &sl->req;
+    int m = q->m, n = q->n, k = q->k;
+    size_t bytes = svdd_result_bytes(q->op, m, n, k);
+    void *out = sl->shm_base ? (char*)sl->shm_base + svdd_result_offset(m, n)
+                             : grow(&sl->out_buf, &sl->out_cap, bytes);
+
+    // Warm tuning profile: the settings autotune found for this shape
+    svdimg_params p = *svdimg_get_params(ctx);
+    const tune_entry *tuned = tune_profile_lookup(&s->profile, m, n, k);
+    p.block = tuned ? tuned->b : SVD_MAX_FIXED_B;
+    p.cheb = tuned ? tuned->cheb : 1;
+    p.threads = tuned && tuned->threads > 0 && tuned->threads < threads ? tuned->threads : threads;
+    p.max_error = q->max_error;
+    p.reproducible = s->reproducible;
+    svdimg_set_params(ctx, &p);
+
+    int rc = SVDIMG_ENOMEM, rank = 0;
+    double err = 0.0;
+    if (out && q->op == SVDD_OP_IMAGE) {
+        rc = svdimg_reconstruct_u8(ctx, sl->pix, m, n, n, k, (unsigned char*)out, n, &err);
+        rank = svdimg_last_rank(ctx);
+    } else if (out) {
+        float *A = (float*)grow(&sl->f_buf, &sl->f_cap, (size_t)m * n * sizeof(float));
+        if (A) {
+            double energy = 0.0;
+            for (size_t i = 0; i < (size_t)m * n; i++) {
+                A[i] = sl->pix[i];
+                energy += (double)A[i] * A[i];
+            }
+            float *S = (float*)out, *U = S + k, *V = U + (size_t)m * k;
+            rc = svdimg_factor(ctx, A, m, n, n, k, U, k, S, V, k);
+            rank = svdimg_last_rank(ctx);
+            // Fewer than k vectors: pack U and V with leading dimension rank
+            for (int i = 0; rank < k && i < m; i++)
+                memmove(S + rank + (size_t)i * rank, U + (size_t)i * k, (size_t)rank * sizeof(float));
+            for (int i = 0; rank < k && i < n; i++)
+                memmove(S + rank + (size_t)m * rank + (size_t)i * rank, V + (size_t)i * k, (size_t)rank * sizeof(float));
+            double left = energy;
+            for (int j = 0; j < rank; j++) left -= (double)S[j] * S[j];
+            err = energy > 0.0 && left > 0.0 ? 100.0 * sqrt(left / energy) : 0.0;
+            bytes = svdd_result_bytes(q->op, m, n, rank);
+        }
+    }
+
+    int status = rc == SVDIMG_OK ? SVDD_OK : rc == SVDIMG_EINVAL ? SVDD_BAD : SVDD_FAIL;
+    if (status == SVDD_OK)
+        send_reply(sl->fd, SVDD_OK, rank, (float)err, out, sl->shm_base ? 0 : bytes);
+    else
+        send_reply(sl->fd, status, 0, 0.0f, NULL, 0);
+    close(sl->fd);
+
+    double lat = now_sec() - sl->t_start;
+    pthread_mutex_lock(&s->stat_lock);
+    if (status == SVDD_OK) {
+        s->served++;
+        s->lat[s->lat_count++ % SVDD_LAT_RING] = lat;
+    } else {
+        s->bad++;
+    }
+    pthread_mutex_unlock(&s->stat_lock);
+}
+
+static void release_slot(svdd_server *s, int idx) {
+    svdd_slot *sl = &s->slots[idx];
+    if (sl->shm_base) munmap(sl->shm_base, sl->shm_size);
+    sl->shm_base = NULL;
+    sl->loaded = 0;
+    pthread_mutex_lock(&s->lock);
+    s->free_list[s->num_free++] = idx;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* Reads one request into a slot. Returns SVDD_OK or the status to send back. */
+static int read_request(svdd_slot *sl) {
+    svdd_request *q = &sl->req;
+    double deadline = sl->t_start + SVDD_READ_SECONDS;
+    if (read_until(sl->fd, q, sizeof(*q), deadline) != 0 || memcmp(q->magic, "SVDQ", 4) != 0)
+        return SVDD_BAD;
+    q->shm[sizeof(q->shm) - 1] = '\0';
+    if (q->op == SVDD_OP_STATS) return SVDD_OK;
+    if (q->op != SVDD_OP_IMAGE && q->op != SVDD_OP_FACTORS) return SVDD_BAD;
+    if (q->m < 1 || q->n < 1 || q->m > SVDD_MAX_SIDE || q->n > SVDD_MAX_SIDE ||
+        (size_t)q->m * q->n > SVDD_MAX_PIXELS || q->k < 1 || q->k > q->m || q->k > q->n ||
+        !(q->max_error >= 0.0f))
+        return SVDD_BAD;
+
+    size_t count = (size_t)q->m * q->n;
+    if (q->shm[0]) {
+        size_t need = svdd_result_offset(q->m, q->n) + svdd_result_bytes(q->op, q->m, q->n, q->k);
+        int sfd = shm_open(q->shm, O_RDWR, 0);
+        struct stat st;
+        if (sfd < 0) return SVDD_FAIL;
+        if (fstat(sfd, &st) != 0 || (size_t)st.st_size < need) {
+            close(sfd);
+            return SVDD_BAD;
+        }
+        void *base = mmap(NULL, need, PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+        close(sfd);
+        if (base == MAP_FAILED) return SVDD_FAIL;
+        sl->shm_base = base;
+        sl->shm_size = need;
+        sl->pix = (unsigned char*)base;
+        return SVDD_OK;
+    }
+    sl->pix = (unsigned char*)grow(&sl->pix_buf, &sl->pix_cap, count);
+    if (!sl->pix) return SVDD_FAIL;
+    return read_until(sl->fd, sl->pix, count, deadline) == 0 ? SVDD_OK : SVDD_BAD;
+}
+
+/* Reads the request of a queued slot on the worker. Stats requests and bad
+   ones are answered here and the slot is released; returns 1 for a job. */
+static int load_slot(svdd_server *s, int idx) {
+    svdd_slot *sl = &s->slots[idx];
+    if (sl->loaded) return 1;
+    int status = read_request(sl);
+    if (status == SVDD_OK && sl->req.op == SVDD_OP_STATS) {
+        char text[512];
+        format_stats(s, text, sizeof(text));
+        send_reply(sl->fd, SVDD_OK, 0, 0.0f, text, strlen(text));
+        close(sl->fd);
+        release_slot(s, idx);
+        return 0;
+    }
+    if (status != SVDD_OK) {
+        send_reply(sl->fd, status, 0, 0.0f, NULL, 0);
+        close(sl->fd);
+        release_slot(s, idx);
+        pthread_mutex_lock(&s->stat_lock);
+        s->bad++;
+        pthread_mutex_unlock(&s->stat_lock);
+        return 0;
+    }
+    sl->loaded = 1;
+    return 1;
+}
+
+static void* worker_main(void *arg) {
+    svdd_server *s = (svdd_server*)arg;
+    svdimg_ctx **ctx = (svdimg_ctx**)calloc((size_t)s->batch, sizeof(svdimg_ctx*));
+    int *take = (int*)malloc((size_t)s->batch * sizeof(int));
+    for (int i = 0; ctx && i < s->batch; i++) ctx[i] = svdimg_create(NULL);
+
+    // Warm up: run a blank image of the expected size once, so the workspace
+    // pages are touched and the OpenMP team exists before the first request.
+    // Small sizes warm every batch context, big ones only the first.
+    int wm = s->warm_m, wn = s->warm_n, wk = s->warm_k;
+    if (ctx && wm > 0 && wn > 0 && wk > 0 && wk <= wm && wk <= wn) {
+        unsigned char *img = (unsigned char*)calloc((size_t)wm * wn, 1);
+        unsigned char *res = (unsigned char*)malloc((size_t)wm * wn);
+        int nw = (size_t)wm * wn <= SVDD_SMALL ? s->batch : 1;
+        for (int i = 0; img && res && i < nw; i++) {
+            svdimg_params p = *svdimg_get_params(ctx[i]);
+            p.threads = nw > 1 ? 1 : s->threads_per_worker;
+            svdimg_set_params(ctx[i], &p);
+            svdimg_reconstruct_u8(ctx[i], img, wm, wn, wn, wk, res, wn, NULL);
+        }
+        free(img);
+        free(res);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (s->count == 0 && !s->quit) pthread_cond_wait(&s->wake, &s->lock);
+        if (s->count == 0 && s->quit) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        int idx = s->ready[s->head];
+        s->head = (s->head + 1) % s->cap;
+        s->count--;
+        pthread_mutex_unlock(&s->lock);
+        if (!load_slot(s, idx)) continue;
+
+        // Batch: the first waiting request, plus more small ones behind it.
+        // A big one read on the way goes back to the front of the queue.
+        int nt = 0;
+        take[nt++] = idx;
+        const svdd_request *q0 = &s->slots[idx].req;
+        while ((size_t)q0->m * q0->n <= SVDD_SMALL && nt < s->batch) {
+            pthread_mutex_lock(&s->lock);
+            if (s->count == 0) {
+                pthread_mutex_unlock(&s->lock);
+                break;
+            }
+            idx = s->ready[s->head];
+            s->head = (s->head + 1) % s->cap;
+            s->count--;
+            pthread_mutex_unlock(&s->lock);
+            if (!load_slot(s, idx)) continue;
+            const svdd_request *q = &s->slots[idx].req;
+            if ((size_t)q->m * q->n > SVDD_SMALL) {
+                pthread_mutex_lock(&s->lock);
+                s->head = (s->head + s->cap - 1) % s->cap;
+                s->ready[s->head] = idx;
+                s->count++;
+                pthread_cond_signal(&s->wake);
+                pthread_mutex_unlock(&s->lock);
+                break;
+            }
+            take[nt++] = idx;
+        }
+
+        if (nt == 1) {
+            run_slot(s, &s->slots[take[0]], ctx[0], s->threads_per_worker);
+        } else {
+            // Small images side by side, the kernels stay serial inside the team
+            #pragma omp parallel for schedule(dynamic) num_threads(s->threads_per_worker)
+            for (int i = 0; i < nt; i++)
+                run_slot(s, &s->slots[take[i]], ctx[i], 1);
+        }
+        for (int i = 0; i < nt; i++) release_slot(s, take[i]);
+
+        pthread_mutex_lock(&s->stat_lock);
+        s->batches++;
+        s->batched_jobs += (unsigned long long)nt;
+        pthread_mutex_unlock(&s->stat_lock);
+    }
+    for (int i = 0; ctx && i < s->batch; i++) svdimg_destroy(ctx[i]);
+    free(ctx);
+    free(take);
+    threads_scratch_release();
+    return NULL;
+}
+
+static int serve(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s serve socket [--workers W] [--threads T] [--queue Q] [--batch B]"
+                        " [--profile file] [--warm m n k] [--repro]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[2];
+    svdd_server s;
+    memset(&s, 0, sizeof(s));
+    int workers = 1, threads = 0, queue = 64, batch = 8;
+    int warm_m = 0, warm_n = 0, warm_k = 0;
+    const char *profile_path = NULL;
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "--workers") == 0 && a + 1 < argc) workers = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--queue") == 0 && a + 1 < argc) queue = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) batch = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) profile_path = argv[++a];
+        else if (strcmp(argv[a], "--repro") == 0) s.reproducible = 1;
+        else if (strcmp(argv[a], "--warm") == 0 && a + 3 < argc) {
+            warm_m = atoi(argv[++a]); warm_n = atoi(argv[++a]); warm_k = atoi(argv[++a]);
+        }
+    }
+    if (workers < 1) workers = 1;
+    if (queue < 1) queue = 1;
+    if (batch < 1) batch = 1;
+    if (threads < 1) threads = threads_count();
+    s.cap = queue;
+    s.batch = batch;
+    s.threads_per_worker = threads / workers > 0 ? threads / workers : 1;
+    s.slots = (svdd_slot*)calloc((size_t)queue, sizeof(svdd_slot));
+    s.free_list = (int*)malloc((size_t)queue * sizeof(int));
+    s.ready = (int*)malloc((size_t)queue * sizeof(int));
+    if (!s.slots || !s.free_list || !s.ready) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return 1;
+    }
+    for (int i = 0; i < queue; i++) s.free_list[s.num_free++] = queue - 1 - i;
+    s.warm_m = warm_m;
+    s.warm_n = warm_n;
+    s.warm_k = warm_k;
+    if (profile_path && tune_profile_load(profile_path, &s.profile) != 0)
+        fprintf(stderr, "Warning: Cannot read profile %s, using the default settings\n", profile_path);
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_mutex_init(&s.stat_lock, NULL);
+    pthread_cond_init(&s.wake, NULL);
+
+    // Warm the pool: pixel and output buffers of every slot for the expected size
+    if (warm_m > 0 && warm_n > 0 && warm_k > 0) {
+        size_t count = (size_t)warm_m * warm_n;
+        size_t out = svdd_result_bytes(SVDD_OP_IMAGE, warm_m, warm_n, warm_k);
+        for (int i = 0; i < queue; i++) {
+            svdd_slot *sl = &s.slots[i];
+            if (grow(&sl->pix_buf, &sl->pix_cap, count)) memset(sl->pix_buf, 0, count);
+            if (grow(&sl->out_buf, &sl->out_cap, out)) memset(sl->out_buf, 0, out);
+        }
+    }
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    if (lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, queue) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s\n", path);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;   // no SA_RESTART, accept returns on a signal
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // The workers block SIGINT/SIGTERM so that they reach the accept loop
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    pthread_t *tid = (pthread_t*)malloc((size_t)workers * sizeof(pthread_t));
+    int started = 0;
+    for (int w = 0; tid && w < workers; w++)
+        if (pthread_create(&tid[w], NULL, worker_main, &s) == 0) started++;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (started == 0) {
+        fprintf(stderr, "Error: could not start the workers\n");
+        return 1;
+    }
+
+    printf("Listening on %s: %d workers x %d threads, queue %d, batch %d\n",
+           path, started, s.threads_per_worker, queue, batch);
+    fflush(stdout);
+
+    while (!stop_flag) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) continue;
+        double t0 = now_sec();
+
+        pthread_mutex_lock(&s.lock);
+        int idx = s.num_free > 0 ? s.free_list[--s.num_free] : -1;
+        pthread_mutex_unlock(&s.lock);
+        if (idx < 0) {
+            // Back-pressure: every slot is taken, answer at once
+            send_reply(fd, SVDD_BUSY, 0, 0.0f, NULL, 0);
+            close(fd);
+            pthread_mutex_lock(&s.stat_lock);
+            s.rejected++;
+            pthread_mutex_unlock(&s.stat_lock);
+            continue;
+        }
+        // The request itself is read by a worker (load_slot)
+        s.slots[idx].fd = fd;
+        s.slots[idx].t_start = t0;
+        pthread_mutex_lock(&s.lock);
+        s.ready[(s.head + s.count) % s.cap] = idx;
+        s.count++;
+        pthread_cond_signal(&s.wake);
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    // Finish what is queued, then stop the workers
+    pthread_mutex_lock(&s.lock);
+    s.quit = 1;
+    pthread_cond_broadcast(&s.wake);
+    pthread_mutex_unlock(&s.lock);
+    for (int w = 0; w < workers; w++)
+        if (w < started) pthread_join(tid[w], NULL);
+    close(lfd);
+    unlink(path);
+
+    char text[512];
+    format_stats(&s, text, sizeof(text));
+    printf("\n%s", text);
+    for (int i = 0; i < queue; i++) {
+        free(s.slots[i].pix_buf);
+        free(s.slots[i].out_buf);
+        free(s.slots[i].f_buf);
+    }
+    free(s.slots); free(s.free_list); free(s.ready); free(tid);
+    return 0;
+}
+
+/*Client*/
+
+/* Sends one request and reads the reply payload into out (out_cap bytes).
+   With shm_name the pixels are already in that object. The server answers
+   BUSY (or BAD) without reading the pixels, so a write that fails with EPIPE
+   still returns that reply; main ignores SIGPIPE for this. */
+static int request(const char *sock, const svdd_request *q, const unsigned char *pix,
+                   svdd_reply *r, void *out, size_t out_cap) {
+    int fd = connect_to(sock);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot connect to %s\n", sock);
+        return -1;
+    }
+    int sent = write_full(fd, q, sizeof(*q)) == 0 &&
+               (q->shm[0] || q->op == SVDD_OP_STATS || write_full(fd, pix, (size_t)q->m * q->n) == 0);
+    int bad = read_full(fd, r, sizeof(*r)) != 0 || memcmp(r->magic, "SVDR", 4) != 0 ||
+              (!sent && r->status == SVDD_OK) ||
+              r->bytes > out_cap || (r->bytes > 0 && read_full(fd, out, (size_t)r->bytes) != 0);
+    close(fd);
+    return bad ? -1 : 0;
+}
+
+static unsigned char* load_u8(const char *path, int *m, int *n) {
+    if (ingest_info(path, m, n) != 0) {
+        fprintf(stderr, "Error: Cannot read %s\n", path);
+        return NULL;
+    }
+    unsigned char *pix = (unsigned char*)malloc((size_t)(*m) * (*n));
+    if (pix && ingest_luma_u8(path, pix, *m, *n) != 0) {
+        fprintf(stderr, "Error: Cannot read %s\n", path);
+        free(pix);
+        return NULL;
+    }
+    return pix;
+}
+
+static void fill_request(svdd_request *q, int op, int m, int n, int k, float max_error) {
+    memset(q, 0, sizeof(*q));
+    memcpy(q->magic, "SVDQ", 4);
+    q->op = op;
+    q->m = m;
+    q->n = n;
+    q->k = k;
+    q->max_error = max_error;
+}
+
+static int send_one(int argc, char **argv) {
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s send socket in_image k out [--error e] [--factors] [--shm]\n", argv[0]);
+        return 1;
+    }
+    int k = atoi(argv[4]), factors = 0, use_shm = 0;
+    float max_error = 0.0f;
+    for (int a = 6; a < argc; a++) {
+        if (strcmp(argv[a], "--error") == 0 && a + 1 < argc) max_error = (float)atof(argv[++a]);
+        else if (strcmp(argv[a], "--factors") == 0) factors = 1;
+        else if (strcmp(argv[a], "--shm") == 0) use_shm = 1;
+    }
+    int m, n;
+    unsigned char *pix = load_u8(argv[3], &m, &n);
+    if (!pix) return 1;
+    svdd_request q;
+    fill_request(&q, factors ? SVDD_OP_FACTORS : SVDD_OP_IMAGE, m, n, k, max_error);
+    size_t bytes = svdd_result_bytes(q.op, m, n, k);
+    void *result = malloc(bytes);
+    void *shm_base = NULL;
+    size_t shm_size = svdd_result_offset(m, n) + bytes;
+    if (use_shm) {
+        snprintf(q.shm, sizeof(q.shm), "/svdd_%d", (int)getpid());
+        int sfd = shm_open(q.shm, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (sfd >= 0 && ftruncate(sfd, (off_t)shm_size) == 0)
+            shm_base = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+        if (sfd >= 0) close(sfd);
+        if (!shm_base || shm_base == MAP_FAILED) {
+            fprintf(stderr, "Error: Cannot create shared memory %s\n", q.shm);
+            shm_unlink(q.shm);
+            free(pix); free(result);
+            return 1;
+        }
+        memcpy(shm_base, pix, (size_t)m * n);
+    }
+
+    svdd_reply r;
+    int ok = result && request(argv[2], &q, pix, &r, result, bytes) == 0 && r.status == SVDD_OK;
+    if (ok && use_shm) memcpy(result, (char*)shm_base + svdd_result_offset(m, n), svdd_result_bytes(q.op, m, n, r.rank));
+    if (use_shm) {
+        munmap(shm_base, shm_size);
+        shm_unlink(q.shm);
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: request failed (status %d)\n", result ? r.status : -1);
+        free(pix); free(result);
+        return 1;
+    }
+    printf("Rank %d, percentage error %.4f%%\n", r.rank, r.error);
+
+    if (factors) {
+        // Same layout as a .svdf file after the header: S, U, V
+        FILE *fp = fopen(argv[5], "wb");
+        int head[3] = { m, n, r.rank };
+        size_t floats = svdd_result_bytes(q.op, m, n, r.rank) / sizeof(float);
+        ok = fp && fwrite("SVDF", 1, 4, fp) == 4 && fwrite(head, sizeof(int), 3, fp) == 3 &&
+             fwrite(result, sizeof(float), floats, fp) == floats;
+        if (fp) fclose(fp);
+    } else {
+        float *buf = (float*)malloc((size_t)m * n * sizeof(float));
+        ok = buf != NULL;
+        for (size_t i = 0; ok && i < (size_t)m * n; i++) buf[i] = ((unsigned char*)result)[i];
+        if (ok) write_pgm(argv[5], buf, m, n);
+        free(buf);
+    }
+    if (ok) printf("Saved %s\n", argv[5]);
+    free(pix);
+    free(result);
+    return ok ? 0 : 1;
+}
+
+static int stats(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s stats socket\n", argv[0]);
+        return 1;
+    }
+    svdd_request q;
+    svdd_reply r;
+    char text[1024];
+    fill_request(&q, SVDD_OP_STATS, 0, 0, 0, 0.0f);
+    if (request(argv[2], &q, NULL, &r, text, sizeof(text) - 1) != 0) return 1;
+    text[r.bytes] = '\0';
+    printf("%s", text);
+    return 0;
+}
+
+typedef struct {
+    const char *sock;
+    const unsigned char *pix;
+    int m, n, k, count;
+    double *lat;            // latencies of the answered requests, done of them
+    int done, busy, failed;
+} bench_client;
+
+static void* bench_main(void *arg) {
+    bench_client *c = (bench_client*)arg;
+    svdd_request q;
+    fill_request(&q, SVDD_OP_IMAGE, c->m, c->n, c->k, 0.0f);
+    unsigned char *out = (unsigned char*)malloc((size_t)c->m * c->n);
+    for (int i = 0; out && i < c->count; i++) {
+        svdd_reply r;
+        double t0 = now_sec();
+        int rc;
+        // BUSY means the queue is full, back off and send again
+        while ((rc = request(c->sock, &q, c->pix, &r, out, (size_t)c->m * c->n)) == 0 && r.status == SVDD_BUSY) {
+            c->busy++;
+            usleep(1000);
+        }
+        if (rc != 0 || r.status != SVDD_OK) c->failed++;
+        else c->lat[c->done++] = now_sec() - t0;
+    }
+    if (!out) c->failed = c->count;
+    free(out);
+    return NULL;
+}
+
+static int bench(int argc, char **argv) {
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s bench socket in_image k count [clients]\n", argv[0]);
+        return 1;
+    }
+    int k = atoi(argv[4]), count = atoi(argv[5]), clients = argc > 6 ? atoi(argv[6]) : 1;
+    if (count < 1) count = 1;
+    if (clients < 1) clients = 1;
+    int m, n;
+    unsigned char *pix = load_u8(argv[3], &m, &n);
+    if (!pix) return 1;
+
+    bench_client *c = (bench_client*)calloc((size_t)clients, sizeof(bench_client));
+    pthread_t *tid = (pthread_t*)malloc((size_t)clients * sizeof(pthread_t));
+    double *lat = (double*)malloc((size_t)clients * count * sizeof(double));
+    if (!c || !tid || !lat) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return 1;
+    }
+    double t0 = now_sec();
+    for (int i = 0; i < clients; i++) {
+        c[i] = (bench_client){ argv[2], pix, m, n, k, count, lat + (size_t)i * count, 0, 0, 0 };
+        pthread_create(&tid[i], NULL, bench_main, &c[i]);
+    }
+    int busy = 0, failed = 0, nl = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tid[i], NULL);
+        busy += c[i].busy;
+        failed += c[i].failed;
+        // Failed requests have no latency, pack the answered ones together
+        memmove(lat + nl, c[i].lat, (size_t)c[i].done * sizeof(double));
+        nl += c[i].done;
+    }
+    double total = now_sec() - t0;
+    qsort(lat, (size_t)nl, sizeof(double), by_value);
+    printf("%d requests from %d clients in %.3f s (%.1f per second), %d busy answers, %d failed\n",
+           nl, clients, total, nl / total, busy, failed);
+    if (nl > 0)
+        printf("client latency: p50 %.3f ms  p95 %.3f ms  p99 %.3f ms\n",
+               1e3 * lat[(nl - 1) * 50 / 100], 1e3 * lat[(nl - 1) * 95 / 100], 1e3 * lat[(nl - 1) * 99 / 100]);
+    free(c); free(tid); free(lat); free(pix);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    signal(SIGPIPE, SIG_IGN);   // a closed socket is an error return, not the end of the process
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0) return serve(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "send") == 0) return send_one(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "stats") == 0) return stats(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) return bench(argc, argv);
+    fprintf(stderr, "Usage: %s serve | send | stats | bench ...\n", argv[0]);
+    return 1;
+}
+
+#else
+
+/* Unix domain sockets and POSIX shared memory only */
+int main(void) {
+    fprintf(stderr, "Error: svd_daemon needs a Unix system\n");
+    return 1;
+}
+
+#endif
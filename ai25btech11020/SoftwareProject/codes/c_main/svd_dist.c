@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svd_dist.h"
+#include "../c_libs/threads.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*Row partitioned block SVD across processes*/
+
+/* Process p owns rows [p*m/P, (p+1)*m/P) of A_res and A_app. One power step is
+
+     Y_p = A_p V,  Z = sum over p of A_pᵀ Y_p     (allreduce through shared memory)
+     V = Q of Z                                (TSQR, Z split in row slices)
+
+   TSQR: every slice is QR'd locally, the small R factors are combined
+   pairwise up a binary tree, and the small Q factors of the tree are then
+   pushed back down so each process can form its slice of the final Q. */
+
+enum { DIST_STEP = 1, DIST_QUIT = 2 };
+
+struct svd_dist_ctl {
+    pthread_barrier_t bar;
+    int cmd;
+    int b, max_iter, prev_cols;
+    int failed;     // rank 0 could not orthogonalize the start block
+    float tol;
+};
+
+static void dist_wait(svd_dist_group *g) {
+    pthread_barrier_wait(&g->ctl->bar);
+}
+
+static size_t align64(size_t x) {
+    return (x + 63) & ~(size_t)63;
+}
+
+/* One block step as seen by process 'rank', returns the iteration count
+   (the same in every process), -1 in every process if it ran out of memory */
+static int dist_step(svd_dist_group *g, int rank) {
+    svd_dist_ctl *ctl = g->ctl;
+    int P = g->nprocs, m = g->m, n = g->n, b = ctl->b, bb = g->bmax * g->bmax;
+
+    int r0 = (int)((long long)rank * m / P), r1 = (int)((long long)(rank + 1) * m / P);
+    int rows = r1 - r0;
+    float *Aloc = g->A_res + (size_t)r0 * n;
+    float *Ploc = g->A_app + (size_t)r0 * n;
+    float *Yloc = g->Y + (size_t)r0 * b;
+    float *Zmine = g->Zpart + (size_t)rank * n * g->bmax;
+
+    // Z is split among nz processes, every slice needs at least b rows
+    int nz = n / b;
+    if (nz > P) nz = P;
+    if (nz < 1) nz = 1;
+    int z0 = 0, z1 = 0;
+    if (rank < nz) {
+        z0 = (int)((long long)rank * n / nz);
+        z1 = (int)((long long)(rank + 1) * n / nz);
+    }
+    int levels = 0;
+    while ((1 << levels) < nz) levels++;
+    float *Ctmp = g->Ctmp, *ritz_prev = g->ritz_prev;
+
+    // Same starting vectors as svd_block_step
+    if (rank == 0) {
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < b; ++j)
+                g->V[(size_t)i * b + j] = 1.0f + 1e-3f * (float)(j + (i % 7));
+        ctl->failed = orthogonalize_against_prev(g->V, n, b, g->PrevV, ctl->prev_cols, g->kmax) != 0;
+    }
+    dist_wait(g);
+    if (ctl->failed) return -1;
+
+    int steps = 0;
+    for (int iter = 0; iter < ctl->max_iter; ++iter) {
+        // Step 1: local Y = A V and Aᵀ Y on my rows
+        matmul_A_times_V(Aloc, g->V, Yloc, rows, n, b);
+        matmul_AT_times_Y(Aloc, Yloc, Zmine, rows, n, b);
+        dist_wait(g);
+
+        // Step 2: add up everybody's contribution for my slice of Z, then local QR
+        for (int z = z0; z < z1; ++z)
+            for (int t = 0; t < b; ++t) {
+                float sum = 0.0f;
+                for (int q = 0; q < P; ++q)
+                    sum += g->Zpart[(size_t)q * n * g->bmax + (size_t)z * b + t];
+                g->Z[(size_t)z * b + t] = sum;
+            }
+        if (rank < nz)
+            qr_modified_gram_schmidt_r(g->Z + (size_t)z0 * b, z1 - z0, b, b, g->R + (size_t)rank * bb);
+        dist_wait(g);
+
+        // Step 3: combine R factors up the tree
+        for (int l = 0; l < levels; ++l) {
+            int step = 1 << l;
+            if (rank % (2 * step) == 0 && rank + step < nz) {
+                float *T = g->Qtree + ((size_t)l * P + rank) * 2 * bb;
+                memcpy(T, g->R + (size_t)rank * bb, (size_t)b * b * sizeof(float));
+                memcpy(T + (size_t)b * b, g->R + (size_t)(rank + step) * bb, (size_t)b * b * sizeof(float));
+                qr_modified_gram_schmidt_r(T, 2 * b, b, b, g->R + (size_t)rank * bb);
+            }
+            dist_wait(g);
+        }
+
+        // Step 4: push the tree Q factors back down, C[p] is what my local Q gets multiplied by
+        if (rank == 0) {
+            float *C0 = g->C;
+            for (int i = 0; i < b; ++i)
+                for (int j = 0; j < b; ++j)
+                    C0[i * b + j] = (i == j) ? 1.0f : 0.0f;
+        }
+        for (int l = levels - 1; l >= 0; --l) {
+            int step = 1 << l;
+            if (rank % (2 * step) == 0 && rank + step < nz) {
+                const float *T = g->Qtree + ((size_t)l * P + rank) * 2 * bb;
+                float *Cme = g->C + (size_t)rank * bb;
+                float *Cchild = g->C + (size_t)(rank + step) * bb;
+                matmul_A_times_V(T + (size_t)b * b, Cme, Cchild, b, b, b);
+                matmul_A_times_V(T, Cme, Ctmp, b, b, b);
+                memcpy(Cme, Ctmp, (size_t)b * b * sizeof(float));
+            }
+            dist_wait(g);
+        }
+
+        // Root R is the R of the whole Z, every process runs the same test on it
+        int done = ritz_converged(g->R, b + 1, b, ritz_prev, iter == 0, ctl->tol);
+
+        // Step 5: my slice of the new V
+        const float *Cme = g->C + (size_t)rank * bb;
+        for (int z = z0; z < z1; ++z) {
+            const float *q = g->Z + (size_t)z * b;
+            float *v = g->V + (size_t)z * b;
+            for (int t = 0; t < b; ++t) {
+                double sum = 0.0;
+                for (int s = 0; s < b; ++s)
+                    sum += (double)q[s] * Cme[s * b + t];
+                v[t] = (float)sum;
+            }
+        }
+        dist_wait(g);
+        steps++;
+        if (done)
+            break;
+    }
+
+    // Singular values need the column norms of the whole Y
+    matmul_A_times_V(Aloc, g->V, Yloc, rows, n, b);
+    for (int j = 0; j < b; ++j) {
+        double sum = 0.0;
+        for (int i = 0; i < rows; ++i) {
+            double val = Yloc[(size_t)i * b + j];
+            sum += val * val;
+        }
+        g->partial[(size_t)rank * g->bmax + j] = sum;
+    }
+    dist_wait(g);
+
+    // Update my rows of A_approx and A_residual (Y = U Σ, so the update is Y Vᵀ)
+    float *keep = ritz_prev; // b floats that are free again
+    for (int j = 0; j < b; ++j) {
+        double sigma_sqrs = 0.0;
+        for (int q = 0; q < P; ++q)
+            sigma_sqrs += g->partial[(size_t)q * g->bmax + j];
+        keep[j] = sqrt(sigma_sqrs) < 1e-12 ? 0.0f : 1.0f;
+    }
+    rank_update(Ploc, Aloc, rows, n, Yloc, keep, g->V, b, Zmine); // Zmine is free again
+    dist_wait(g);
+    return steps;
+}
+
+/* Loop run by the forked processes until they are told to quit */
+static void dist_worker(svd_dist_group *g, int rank) {
+    threads_set(1); // the processes already share out the cores
+    for (;;) {
+        dist_wait(g);
+        if (g->ctl->cmd == DIST_QUIT)
+            _exit(0);
+        dist_step(g, rank);
+    }
+}
+
+/* Creates the shared buffers and forks nprocs-1 helper processes.
+   The caller is process 0. Returns NULL if anything fails. */
+svd_dist_group* svd_dist_start(int nprocs, int m, int n, int bmax, int kmax) {
+    if (nprocs < 1 || m <= 0 || n <= 0 || bmax <= 0 || kmax <= 0) return NULL;
+    svd_dist_group *g = (svd_dist_group*)calloc(1, sizeof(svd_dist_group));
+    if (!g) return NULL;
+    g->nprocs = nprocs; g->m = m; g->n = n; g->bmax = bmax; g->kmax = kmax;
+
+    // Allocated before fork, so every process gets its own copy
+    g->Ctmp = (float*)malloc((size_t)bmax * bmax * sizeof(float));
+    g->ritz_prev = (float*)malloc((size_t)bmax * sizeof(float));
+    if (!g->Ctmp || !g->ritz_prev) { free(g->Ctmp); free(g->ritz_prev); free(g); return NULL; }
+
+    int levels = 1;
+    while ((1 << levels) < nprocs) levels++;
+    size_t bb = (size_t)bmax * bmax;
+
+    // Work out where every buffer goes inside the mapping
+    size_t off_ctl = 0;
+    size_t off_partial = align64(off_ctl + sizeof(svd_dist_ctl));
+    size_t off_Ares = align64(off_partial + (size_t)nprocs * bmax * sizeof(double));
+    size_t off_Aapp = align64(off_Ares + (size_t)m * n * sizeof(float));
+    size_t off_V = align64(off_Aapp + (size_t)m * n * sizeof(float));
+    size_t off_Prev = align64(off_V + (size_t)n * bmax * sizeof(float));
+    size_t off_Y = align64(off_Prev + (size_t)n * kmax * sizeof(float));
+    size_t off_Z = align64(off_Y + (size_t)m * bmax * sizeof(float));
+    size_t off_Zpart = align64(off_Z + (size_t)n * bmax * sizeof(float));
+    size_t off_R = align64(off_Zpart + (size_t)nprocs * n * bmax * sizeof(float));
+    size_t off_Qtree = align64(off_R + (size_t)nprocs * bb * sizeof(float));
+    size_t off_C = align64(off_Qtree + (size_t)levels * nprocs * 2 * bb * sizeof(float));
+    size_t total = align64(off_C + (size_t)nprocs * bb * sizeof(float));
+
+    char *base = (char*)mmap(NULL, total, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) { free(g->Ctmp); free(g->ritz_prev); free(g); return NULL; }
+    g->shm = base;
+    g->shm_size = total;
+    g->ctl = (svd_dist_ctl*)(base + off_ctl);
+    g->partial = (double*)(base + off_partial);
+    g->A_res = (float*)(base + off_Ares);
+    g->A_app = (float*)(base + off_Aapp);
+    g->V = (float*)(base + off_V);
+    g->PrevV = (float*)(base + off_Prev);
+    g->Y = (float*)(base + off_Y);
+    g->Z = (float*)(base + off_Z);
+    g->Zpart = (float*)(base + off_Zpart);
+    g->R = (float*)(base + off_R);
+    g->Qtree = (float*)(base + off_Qtree);
+    g->C = (float*)(base + off_C);
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    int rc = pthread_barrier_init(&g->ctl->bar, &attr, (unsigned)nprocs);
+    pthread_barrierattr_destroy(&attr);
+    if (rc != 0) { munmap(base, total); free(g->Ctmp); free(g->ritz_prev); free(g); return NULL; }
+
+    g->pids = (int*)calloc((size_t)nprocs, sizeof(int));
+    if (!g->pids) {
+        pthread_barrier_destroy(&g->ctl->bar);
+        munmap(base, total); free(g->Ctmp); free(g->ritz_prev); free(g);
+        return NULL;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int p = 1; p < nprocs; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) dist_worker(g, p);
+        if (pid < 0) {
+            fprintf(stderr, "Error: fork failed for process %d\n", p);
+            for (int q = 1; q < p; ++q) kill(g->pids[q], SIGKILL);
+            for (int q = 1; q < p; ++q) waitpid(g->pids[q], NULL, 0);
+            pthread_barrier_destroy(&g->ctl->bar);
+            munmap(base, total); free(g->pids); free(g->Ctmp); free(g->ritz_prev); free(g);
+            return NULL;
+        }
+        g->pids[p] = (int)pid;
+    }
+    return g;
+}
+
+/* Runs one svd_block_step across all processes and appends the new
+   b vectors to PrevV, like the copy loop in main.c. Returns the number of
+   iterations, -1 if b does not fit or the step ran out of memory */
+int svd_dist_block_step(svd_dist_group *g, int b, int max_iter, float tol) {
+    svd_dist_ctl *ctl = g->ctl;
+    if (b > g->bmax || ctl->prev_cols + b > g->kmax) return -1;
+    ctl->cmd = DIST_STEP;
+    ctl->b = b;
+    ctl->max_iter = max_iter;
+    ctl->tol = tol;
+    dist_wait(g);
+    int steps = dist_step(g, 0);
+    if (steps < 0) return -1;
+
+    for (int j = 0; j < b; ++j)
+        for (int i = 0; i < g->n; ++i)
+            g->PrevV[(size_t)i * g->kmax + (ctl->prev_cols + j)] = g->V[(size_t)i * b + j];
+    ctl->prev_cols += b;
+    return steps;
+}
+
+void svd_dist_stop(svd_dist_group *g) {
+    if (!g) return;
+    g->ctl->cmd = DIST_QUIT;
+    dist_wait(g);
+    for (int p = 1; p < g->nprocs; ++p)
+        waitpid(g->pids[p], NULL, 0);
+    pthread_barrier_destroy(&g->ctl->bar);
+    munmap(g->shm, g->shm_size);
+    free(g->pids);
+    free(g->Ctmp);
+    free(g->ritz_prev);
+    free(g);
+}
+
+#else
+
+/* No fork or process shared barriers here, callers fall back to svd_block_step */
+svd_dist_group* svd_dist_start(int nprocs, int m, int n, int bmax, int kmax) {
+    (void)nprocs; (void)m; (void)n; (void)bmax; (void)kmax;
+    return NULL;
+}
+
+int svd_dist_block_step(svd_dist_group *g, int b, int max_iter, float tol) {
+    (void)g; (void)b; (void)max_iter; (void)tol;
+    return -1;
+}
+
+void svd_dist_stop(svd_dist_group *g) {
+    (void)g;
+}
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_factors.h"
+#include "../c_libs/threads.h"
+
+/*Stored factors*/
+
+int svd_factors_init(svd_factors *f, int m, int n, int kmax) {
+    memset(f, 0, sizeof(*f));
+    if (m <= 0 || n <= 0 || kmax <= 0) return -1;
+    f->m = m;
+    f->n = n;
+    f->kmax = kmax;
+    f->S = (float*)calloc((size_t)kmax, sizeof(float));
+    f->U = (float*)calloc((size_t)m * kmax, sizeof(float));
+    f->V = (float*)calloc((size_t)n * kmax, sizeof(float));
+    if (!f->S || !f->U || !f->V) {
+        svd_factors_free(f);
+        return -1;
+    }
+    return 0;
+}
+
+/* Appends the b vectors of one block step. Y = A_res V (m×b) is U Σ, so
+   sigma is the length of each column of Y and U is Y / sigma.
+   V is n×b (leading dimension b). Returns -1 when there is no room. */
+int svd_factors_add_block(svd_factors *f, const float *Y, const float *V, int b) {
+    if (f->k + b > f->kmax) return -1;
+    for (int j = 0; j < b; ++j) {
+        int col = f->k + j;
+        double sq = 0.0;
+        for (int i = 0; i < f->m; ++i) {
+            double y = Y[(size_t)i * b + j];
+            sq += y * y;
+        }
+        double sigma = sqrt(sq);
+        float inv = sigma < 1e-12 ? 0.0f : (float)(1.0 / sigma);
+        f->S[col] = sigma < 1e-12 ? 0.0f : (float)sigma;
+        for (int i = 0; i < f->m; ++i)
+            f->U[(size_t)i * f->kmax + col] = Y[(size_t)i * b + j] * inv;
+        for (int i = 0; i < f->n; ++i)
+            f->V[(size_t)i * f->kmax + col] = V[(size_t)i * b + j];
+    }
+    f->k += b;
+    return 0;
+}
+
+/* Writes rows of a matrix with leading dimension ld as rows of k floats */
+static int write_rows(FILE *fp, const float *X, int rows, int k, int ld) {
+    for (int i = 0; i < rows; ++i)
+        if (fwrite(X + (size_t)i * ld, sizeof(float), (size_t)k, fp) != (size_t)k)
+            return -1;
+    return 0;
+}
+
+int svd_factors_save(const char *path, const svd_factors *f) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+    int head[3] = { f->m, f->n, f->k };
+    int bad = fwrite("SVDF", 1, 4, fp) != 4 ||
+              fwrite(head, sizeof(int), 3, fp) != 3 ||
+              fwrite(f->S, sizeof(float), (size_t)f->k, fp) != (size_t)f->k ||
+              write_rows(fp, f->U, f->m, f->k, f->kmax) != 0 ||
+              write_rows(fp, f->V, f->n, f->k, f->kmax) != 0;
+    fclose(fp);
+    return bad ? -1 : 0;
+}
+
+/* Reads the header, returns the open file positioned at S or NULL */
+static FILE* open_factors(const char *path, int *m, int *n, int *k) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return NULL;
+    }
+    char magic[4];
+    int head[3];
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, "SVDF", 4) != 0 ||
+        fread(head, sizeof(int), 3, fp) != 3 ||
+        head[0] <= 0 || head[1] <= 0 || head[2] <= 0) {
+        fprintf(stderr, "%s is not a factor file (.svdf)\n", path);
+        fclose(fp);
+        return NULL;
+    }
+    *m = head[0]; *n = head[1]; *k = head[2];
+    return fp;
+}
+
+int svd_factors_load(const char *path, svd_factors *f) {
+    int m, n, k;
+    FILE *fp = open_factors(path, &m, &n, &k);
+    if (!fp) {
+        memset(f, 0, sizeof(*f));
+        return -1;
+    }
+    if (svd_factors_init(f, m, n, k) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    f->k = k;
+    int bad = fread(f->S, sizeof(float), (size_t)k, fp) != (size_t)k ||
+              fread(f->U, sizeof(float), (size_t)m * k, fp) != (size_t)m * k ||
+              fread(f->V, sizeof(float), (size_t)n * k, fp) != (size_t)n * k;
+    fclose(fp);
+    if (bad) {
+        fprintf(stderr, "%s is cut short\n", path);
+        svd_factors_free(f);
+        return -1;
+    }
+    return 0;
+}
+
+void svd_factors_free(svd_factors *f) {
+    free(f->S); free(f->U); free(f->V);
+    memset(f, 0, sizeof(*f));
+}
+
+/*Window reconstruction*/
+
+/* out(i, c) = sum_j U(i, j) S(j) V(c, j) for the given rows of U and V.
+   Each row of U is scaled by S once, then every pixel is one dot product
+   of two contiguous rows, split over threads by output row. */
+static void window_product(const float *U, int ldu, const float *S, const float *V, int ldv,
+                           int rank, int h, int w, float *out, int ld_out) {
+#ifdef _OPENMP
+    int T = threads_count();
+#endif
+    #pragma omp parallel num_threads(T) if (T > 1 && h >= 2 * T)
+    {
+        float *us = (float*)malloc((size_t)rank * sizeof(float));
+        if (us) {
+            #pragma omp for schedule(static)
+            for (int i = 0; i < h; ++i) {
+                const float *u = U + (size_t)i * ldu;
+                for (int j = 0; j < rank; ++j) us[j] = u[j] * S[j];
+                float *row = out + (size_t)i * ld_out;
+                for (int c = 0; c < w; ++c) {
+                    const float *v = V + (size_t)c * ldv;
+                    float sum = 0.0f;
+                    #pragma omp simd reduction(+:sum)
+                    for (int j = 0; j < rank; ++j)
+                        sum += us[j] * v[j];
+                    row[c] = sum;
+                }
+            }
+            free(us);
+        }
+    }
+}
+
+/* Keeps the window and rank inside the matrix, returns 0 if nothing is left */
+static int clip_window(int m, int n, int k, int *rank, int *r0, int *c0, int *h, int *w) {
+    if (*rank <= 0 || *rank > k) *rank = k;
+    if (*r0 < 0) { *h += *r0; *r0 = 0; }
+    if (*c0 < 0) { *w += *c0; *c0 = 0; }
+    if (*r0 + *h > m) *h = m - *r0;
+    if (*c0 + *w > n) *w = n - *c0;
+    return *h > 0 && *w > 0;
+}
+
+void svd_reconstruct_window(const svd_factors *f, int rank, int r0, int c0,
+                            int h, int w, float *out, int ld_out) {
+    if (!clip_window(f->m, f->n, f->k, &rank, &r0, &c0, &h, &w)) return;
+    window_product(f->U + (size_t)r0 * f->kmax, f->kmax, f->S,
+                   f->V + (size_t)c0 * f->kmax, f->kmax, rank, h, w, out, ld_out);
+}
+
+/* Reads S, rows r0..r0+h of U and rows c0..c0+w of V (each a contiguous
+   run in the file) and rebuilds the window. Returns 0 on success. */
+int svd_factors_read_window(const char *path, int rank, int r0, int c0,
+                            int h, int w, float *out, int ld_out) {
+    int m, n, k;
+    FILE *fp = open_factors(path, &m, &n, &k);
+    if (!fp) return -1;
+    if (!clip_window(m, n, k, &rank, &r0, &c0, &h, &w)) {
+        fclose(fp);
+        return 0;
+    }
+
+    float *S = (float*)malloc((size_t)k * sizeof(float));
+    float *U = (float*)malloc((size_t)h * k * sizeof(float));
+    float *V = (float*)malloc((size_t)w * k * sizeof(float));
+    long head = 4 + 3 * (long)sizeof(int);
+    long u_at = head + (long)k * sizeof(float) + (long)r0 * k * sizeof(float);
+    long v_at = head + (long)k * sizeof(float) + (long)m * k * sizeof(float) + (long)c0 * k * sizeof(float);
+    int bad = !S || !U || !V ||
+              fread(S, sizeof(float), (size_t)k, fp) != (size_t)k ||
+              fseek(fp, u_at, SEEK_SET) != 0 ||
+              fread(U, sizeof(float), (size_t)h * k, fp) != (size_t)h * k ||
+              fseek(fp, v_at, SEEK_SET) != 0 ||
+              fread(V, sizeof(float), (size_t)w * k, fp) != (size_t)w * k;
+    fclose(fp);
+    if (!bad)
+        window_product(U, k, S, V, k, rank, h, w, out, ld_out);
+    else
+        fprintf(stderr, "%s is cut short\n", path);
+    free(S); free(U); free(V);
+    return bad ? -1 : 0;
+}
+
+/*Thumbnails*/
+
+static double sinc(double x) {
+    if (fabs(x) < 1e-8) return 1.0;
+    x *= 3.14159265358979323846;
+    return sin(x) / x;
+}
+
+/* Xo (out_rows×k) = F X, where row o of the filter F is the box or Lanczos
+   weight of every source row for output row o. Downscaling a matrix along
+   its rows this way and then multiplying by the other factor is the same as
+   filtering the product, because the filter is linear. */
+static void resample_rows(const float *X, int ldx, int rows, int k,
+                          int out_rows, int filter, float *Xo) {
+    double scale = (double)rows / out_rows;
+    double width = scale > 1.0 ? scale : 1.0;   // widen the kernel when shrinking
+    for (int o = 0; o < out_rows; ++o) {
+        float *xo = Xo + (size_t)o * k;
+        for (int j = 0; j < k; ++j) xo[j] = 0.0f;
+
+        int s0, s1;
+        double center = (o + 0.5) * scale - 0.5;
+        if (filter == SVD_THUMB_LANCZOS) {
+            s0 = (int)ceil(center - 3.0 * width);
+            s1 = (int)floor(center + 3.0 * width);
+        } else {
+            s0 = (int)floor(o * scale);
+            s1 = (int)ceil((o + 1) * scale) - 1;
+        }
+
+        double total = 0.0;
+        for (int s = s0; s <= s1; ++s) {
+            double wgt;
+            if (filter == SVD_THUMB_LANCZOS) {
+                double x = (s - center) / width;
+                wgt = fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+            } else {
+                // part of source row s inside [o*scale, (o+1)*scale)
+                double lo = s > o * scale ? s : o * scale;
+                double hi = s + 1 < (o + 1) * scale ? s + 1 : (o + 1) * scale;
+                wgt = hi - lo;
+            }
+            if (wgt == 0.0) continue;
+            int src = s < 0 ? 0 : (s >= rows ? rows - 1 : s);   // repeat the edge
+            const float *x = X + (size_t)src * ldx;
+            for (int j = 0; j < k; ++j) xo[j] += (float)wgt * x[j];
+            total += wgt;
+        }
+        if (total != 0.0)
+            for (int j = 0; j < k; ++j) xo[j] = (float)(xo[j] / total);
+    }
+}
+
+int svd_reconstruct_thumbnail(const svd_factors *f, int rank, int th, int tw,
+                              int filter, float *out, int ld_out) {
+    if (th <= 0 || tw <= 0) return -1;
+    if (rank <= 0 || rank > f->k) rank = f->k;
+    float *Ut = (float*)malloc((size_t)th * rank * sizeof(float));
+    float *Vt = (float*)malloc((size_t)tw * rank * sizeof(float));
+    if (!Ut || !Vt) {
+        free(Ut); free(Vt);
+        return -1;
+    }
+    resample_rows(f->U, f->kmax, f->m, rank, th, filter, Ut);
+    resample_rows(f->V, f->kmax, f->n, rank, tw, filter, Vt);
+    window_product(Ut, rank, f->S, Vt, rank, rank, th, tw, out, ld_out);
+    free(Ut); free(Vt);
+    return 0;
+}
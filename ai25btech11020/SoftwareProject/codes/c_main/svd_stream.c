@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svd_stream.h"
+
+/*Incremental (row appended) SVD*/
+
+/* Brand style update: if the rows seen so far are A ~ U S Vᵀ and a new
+   batch B arrives then
+
+       [A]   [U 0] [S    0 ] [V J]ᵀ
+       [B] = [0 I] [L   Kᵀ ]
+
+   with L = B V, H = B - L Vᵀ and Hᵀ = J K (QR). Only the small middle
+   matrix needs a full SVD, after which everything is cut back to max_rank.
+   The scratch memory depends on n, max_rank and the batch size only.
+
+   Turning the old rows of U by the k×r top block of the middle U on every
+   batch would cost rows·k·r each time, so quadratic in the height. The
+   rows are kept in chunks instead, each with its own small rotation W
+   that takes the turn; the rows themselves are only rewritten when two
+   chunks are merged, which keeps the total cost linear up to a log. */
+
+int svd_stream_init(svd_stream *s, int n, int max_rank) {
+    memset(s, 0, sizeof(*s));
+    if (n <= 0 || max_rank <= 0) return -1;
+
+    int pb = n < SVD_STREAM_MAX_BATCH ? n : SVD_STREAM_MAX_BATCH;
+    int d = max_rank + pb;
+    s->n = n;
+    s->max_rank = max_rank;
+
+    s->S = (float*)calloc((size_t)max_rank, sizeof(float));
+    s->V = (float*)malloc((size_t)n * max_rank * sizeof(float));
+    s->L = (float*)malloc((size_t)pb * max_rank * sizeof(float));
+    s->H = (float*)malloc((size_t)pb * n * sizeof(float));
+    s->J = (float*)malloc((size_t)n * pb * sizeof(float));
+    s->KT = (float*)malloc((size_t)pb * pb * sizeof(float));
+    s->M = (float*)malloc((size_t)d * d * sizeof(float));
+    s->Um = (float*)malloc((size_t)d * d * sizeof(float));
+    s->Sm = (float*)malloc((size_t)d * sizeof(float));
+    s->Vm = (float*)malloc((size_t)d * d * sizeof(float));
+    s->VJ = (float*)malloc((size_t)n * d * sizeof(float));
+    s->Vnew = (float*)malloc((size_t)n * max_rank * sizeof(float));
+    s->row_tmp = (float*)malloc((size_t)max_rank * sizeof(float));
+
+    if (!s->S || !s->V || !s->L || !s->H || !s->J || !s->KT || !s->M || !s->Um ||
+        !s->Sm || !s->Vm || !s->VJ || !s->Vnew || !s->row_tmp) {
+        svd_stream_free(s);
+        return -1;
+    }
+    return 0;
+}
+
+/* W_c = W_c * A(0:k, 0:r), A with leading dimension lda */
+static void chunk_rotate(svd_stream *s, int c, const float *A, int lda, int k, int r) {
+    int K = s->max_rank;
+    float *W = s->W + (size_t)c * K * K;
+    for (int i = 0; i < s->chunk_w[c]; ++i) {
+        float *row = W + (size_t)i * K;
+        for (int t = 0; t < r; ++t) {
+            double sum = 0.0;
+            for (int j = 0; j < k; ++j)
+                sum += (double)row[j] * A[(size_t)j * lda + t];
+            s->row_tmp[t] = (float)sum;
+        }
+        memcpy(row, s->row_tmp, (size_t)r * sizeof(float));
+    }
+}
+
+static void chunk_identity(svd_stream *s, int c) {
+    int K = s->max_rank, r = s->rank;
+    float *W = s->W + (size_t)c * K * K;
+    for (int i = 0; i < r; ++i) {
+        memset(W + (size_t)i * K, 0, (size_t)r * sizeof(float));
+        W[(size_t)i * K + i] = 1.0f;
+    }
+    s->chunk_w[c] = r;
+}
+
+/* Row i of the real U (rank values) into out */
+static void chunk_row_real(const svd_stream *s, int c, int i, float *out) {
+    int K = s->max_rank;
+    const float *u = s->U + (size_t)(s->chunk_row[c] + i) * K;
+    const float *W = s->W + (size_t)c * K * K;
+    for (int t = 0; t < s->rank; ++t) {
+        double sum = 0.0;
+        for (int j = 0; j < s->chunk_w[c]; ++j)
+            sum += (double)u[j] * W[(size_t)j * K + t];
+        out[t] = (float)sum;
+    }
+}
+
+/* Applies W_c to the rows of chunk c, after which W_c is the identity */
+static void chunk_flatten(svd_stream *s, int c) {
+    int K = s->max_rank;
+    for (int i = 0; i < s->chunk_len[c]; ++i) {
+        chunk_row_real(s, c, i, s->row_tmp);
+        memcpy(s->U + (size_t)(s->chunk_row[c] + i) * K, s->row_tmp, (size_t)s->rank * sizeof(float));
+    }
+    chunk_identity(s, c);
+}
+
+/* Merges the last chunk into the one before it */
+static void chunk_merge_last(svd_stream *s) {
+    int c = s->chunks - 1;
+    chunk_flatten(s, c - 1);
+    chunk_flatten(s, c);
+    s->chunk_len[c - 1] += s->chunk_len[c];
+    s->chunks--;
+}
+
+/* Column i of J (n×p) minus its part along the k columns of V and the
+   first i columns of J, done twice so rounding leaves nothing along them.
+   Scaled to length 1, or set to zero when less than tiny is left: then
+   the new rows add no direction there (rank deficient input), and a
+   column made of rounding residue would only bring a spurious value */
+static void new_direction(float *J, int n, int p, int i, const float *V, int k, double tiny) {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int j = 0; j < k + i; ++j) {
+            const float *q = j < k ? V + j : J + (j - k);
+            int ld = j < k ? k : p;
+            double dot = 0.0;
+            for (int c = 0; c < n; ++c)
+                dot += (double)q[(size_t)c * ld] * J[(size_t)c * p + i];
+            for (int c = 0; c < n; ++c)
+                J[(size_t)c * p + i] -= (float)(dot * q[(size_t)c * ld]);
+        }
+    }
+    double len = 0.0;
+    for (int c = 0; c < n; ++c)
+        len += (double)J[(size_t)c * p + i] * J[(size_t)c * p + i];
+    len = sqrt(len);
+    float scale = len > tiny ? (float)(1.0 / len) : 0.0f;
+    for (int c = 0; c < n; ++c)
+        J[(size_t)c * p + i] *= scale;
+}
+
+/* Folds p rows (p <= SVD_STREAM_MAX_BATCH, p <= n) into the factorization */
+static int stream_update(svd_stream *s, const float *B, int p) {
+    int n = s->n, k = s->rank, K = s->max_rank;
+    int d = k + p;
+
+    // Make room for the new rows of U (doubling, so appends stay cheap)
+    if (s->rows + p > s->row_cap) {
+        int cap = s->row_cap ? s->row_cap : 64;
+        while (cap < s->rows + p) cap *= 2;
+        float *U = (float*)realloc(s->U, (size_t)cap * K * sizeof(float));
+        if (!U) return -1;
+        s->U = U;
+        s->row_cap = cap;
+    }
+    if (s->chunks + 1 > s->w_cap) {
+        float *W = (float*)realloc(s->W, (size_t)(s->chunks + 1) * K * K * sizeof(float));
+        if (!W) return -1;
+        s->W = W;
+        s->w_cap = s->chunks + 1;
+    }
+
+    // Step 1: L = B V, the part of the new rows already in the basis
+    if (k > 0)
+        matmul_A_times_V(B, s->V, s->L, p, n, k);
+
+    // Step 2: H = B - L Vᵀ, the new directions
+    double normB = 0.0;
+    for (size_t i = 0; i < (size_t)p * n; ++i)
+        normB += (double)B[i] * B[i];
+    normB = sqrt(normB);
+    for (int i = 0; i < p; ++i) {
+        for (int c = 0; c < n; ++c) {
+            double sum = B[(size_t)i * n + c];
+            for (int j = 0; j < k; ++j)
+                sum -= (double)s->L[(size_t)i * k + j] * s->V[(size_t)c * k + j];
+            s->H[(size_t)i * n + c] = (float)sum;
+        }
+    }
+
+    // Step 3: J = orthonormal basis of Hᵀ, orthogonal to V, Kᵀ = H J.
+    // Directions shorter than a few ulps of B are rounding, not data
+    for (int i = 0; i < p; ++i)
+        for (int c = 0; c < n; ++c)
+            s->J[(size_t)c * p + i] = s->H[(size_t)i * n + c];
+    for (int i = 0; i < p; ++i)
+        new_direction(s->J, n, p, i, s->V, k, 4.0 * FLT_EPSILON * normB);
+    matmul_A_times_V(s->H, s->J, s->KT, p, n, p);
+
+    // Step 4: middle matrix M = [S 0; L Kᵀ] and its SVD
+    memset(s->M, 0, (size_t)d * d * sizeof(float));
+    for (int j = 0; j < k; ++j)
+        s->M[(size_t)j * d + j] = s->S[j];
+    for (int i = 0; i < p; ++i) {
+        for (int j = 0; j < k; ++j)
+            s->M[(size_t)(k + i) * d + j] = s->L[(size_t)i * k + j];
+        for (int j = 0; j < p; ++j)
+            s->M[(size_t)(k + i) * d + k + j] = s->KT[(size_t)i * p + j];
+    }
+    small_svd_jacobi(s->M, d, d, s->Um, s->Sm, s->Vm);
+
+    // Step 5: truncate to max_rank and drop the directions that are zero
+    // up to float rounding (n·eps relative to the largest value)
+    int r = d < K ? d : K;
+    while (r > 0 && s->Sm[r - 1] <= (float)n * FLT_EPSILON * s->Sm[0])
+        r--;
+    if (r == 0) r = 1;
+
+    // Step 6: V = [V J] Vm(:, 1:r)
+    for (int c = 0; c < n; ++c) {
+        float *row = s->VJ + (size_t)c * d;
+        for (int j = 0; j < k; ++j) row[j] = s->V[(size_t)c * k + j];
+        for (int j = 0; j < p; ++j) row[k + j] = s->J[(size_t)c * p + j];
+    }
+    for (int i = 0; i < d; ++i)
+        for (int t = 0; t < r; ++t)
+            s->M[(size_t)i * r + t] = s->Vm[(size_t)i * d + t];
+    matmul_A_times_V(s->VJ, s->M, s->Vnew, n, d, r);
+    memcpy(s->V, s->Vnew, (size_t)n * r * sizeof(float));
+
+    // Step 7: old rows of U turn by the top block of Um (only the chunk
+    // rotations do), the new rows are its bottom block, as a new chunk
+    for (int c = 0; c < s->chunks; ++c)
+        chunk_rotate(s, c, s->Um, d, k, r);
+    int c = s->chunks++;
+    s->chunk_row[c] = s->rows;
+    s->chunk_len[c] = p;
+    for (int i = 0; i < p; ++i) {
+        float *row = s->U + (size_t)(s->rows + i) * K;
+        for (int t = 0; t < r; ++t)
+            row[t] = s->Um[(size_t)(k + i) * d + t];
+    }
+    memcpy(s->S, s->Sm, (size_t)r * sizeof(float));
+    s->rank = r;
+    s->rows += p;
+    chunk_identity(s, c);
+
+    // Every chunk stays more than twice the size of the next one, so there
+    // are only about log2(rows) of them and a row is rewritten log times
+    while (s->chunks > 1 && 2 * s->chunk_len[s->chunks - 1] > s->chunk_len[s->chunks - 2])
+        chunk_merge_last(s);
+    return 0;
+}
+
+/* Adds count new rows (count×n, row major) at the bottom of the image */
+int svd_stream_push_rows(svd_stream *s, const float *rows, int count) {
+    int pb = s->n < SVD_STREAM_MAX_BATCH ? s->n : SVD_STREAM_MAX_BATCH;
+    while (count > 0) {
+        int p = count < pb ? count : pb;
+        if (stream_update(s, rows, p) != 0) return -1;
+        rows += (size_t)p * s->n;
+        count -= p;
+    }
+    return 0;
+}
+
+/* Applies all chunk rotations, after this s->U is the real U */
+void svd_stream_finalize(svd_stream *s) {
+    while (s->chunks > 1)
+        chunk_merge_last(s);
+    if (s->chunks == 1)
+        chunk_flatten(s, 0);
+}
+
+/* Writes U S Vᵀ (rows×n) into A_out */
+void svd_stream_reconstruct(const svd_stream *s, float *A_out) {
+    int n = s->n, k = s->rank;
+    for (int c = 0; c < s->chunks; ++c) {
+        for (int i = 0; i < s->chunk_len[c]; ++i) {
+            float *u = s->row_tmp;
+            chunk_row_real(s, c, i, u);
+            float *out = A_out + (size_t)(s->chunk_row[c] + i) * n;
+            for (int x = 0; x < n; ++x) {
+                double sum = 0.0;
+                for (int j = 0; j < k; ++j)
+                    sum += (double)u[j] * s->S[j] * s->V[(size_t)x * k + j];
+                out[x] = (float)sum;
+            }
+        }
+    }
+}
+
+void svd_stream_free(svd_stream *s) {
+    free(s->U); free(s->S); free(s->V); free(s->W);
+    free(s->L); free(s->H); free(s->J); free(s->KT);
+    free(s->M); free(s->Um); free(s->Sm); free(s->Vm);
+    free(s->VJ); free(s->Vnew); free(s->row_tmp);
+    memset(s, 0, sizeof(*s));
+}
@@ -2,7 +2,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
-#include "..\c_libs\svd_utils.h"
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/threads.h"
 
 /*Basic Vector Utility Functions*/
 
@@ -25,9 +26,11 @@ void normalize_vector(float *vec, int length) {
 
 /*Matrix Multiplication Functions*/
 
+/* Generic versions, used when b is bigger than SVD_MAX_FIXED_B */
+
 /* Multiply matrices like this: Y = A * V
    A is of size m×n, V is n×b, result Y will be m×b */
-void matmul_A_times_V(const float *A, const float *V, float *Y, int m, int n, int b) {
+static void matmul_A_times_V_any(const float *A, const float *V, float *Y, int m, int n, int b) {
     for (int i = 0; i < m; ++i) {
         const float *rowA = A + (size_t)i * n;
         float *rowY = Y + (size_t)i * b;
@@ -47,18 +50,19 @@ void matmul_A_times_V(const float *A, const float *V, float *Y, int m, int n, in
 }
 
 /* Multiply matrices like this: Z = Aᵀ * Y
-   Here A is m×n, Y is m×b, so result Z will be n×b */
-void matmul_AT_times_Y(const float *A, const float *Y, float *Z, int m, int n, int b) {
+   Here A is m×n, Y is m×b, so result Z will be n×b.
+   With add the sums carry on from what is in Z (Z += Aᵀ * Y) */
+static void matmul_AT_times_Y_any(const float *A, int lda, const float *Y, float *Z, int m, int n, int b, int add) {
     for (int j = 0; j < n; ++j) {
         float *colZ = Z + (size_t)j * b;
 
         // Make this column zero first
-        for (int t = 0; t < b; ++t)
+        for (int t = 0; t < b && !add; ++t)
             colZ[t] = 0.0f;
 
         // Multiply A transpose with Y
         for (int i = 0; i < m; ++i) {
-            float a_val = A[(size_t)i * n + j];
+            float a_val = A[(size_t)i * lda + j];
             const float *rowY = Y + (size_t)i * b;
             for (int t = 0; t < b; ++t)
                 colZ[t] += a_val * rowY[t];
@@ -66,13 +70,178 @@ void matmul_AT_times_Y(const float *A, const float *Y, float *Z, int m, int n, i
     }
 }
 
+/* Same loops with b fixed at compile time: the j/t loops unroll completely
+   and the b running sums live in registers instead of in Y / Z */
+#define DEFINE_FIXED_B_KERNELS(B)                                                    \
+static void matmul_A_times_V_b##B(const float *A, const float *V, float *Y, int m, int n) { \
+    for (int i = 0; i < m; ++i) {                                                    \
+        const float *rowA = A + (size_t)i * n;                                       \
+        float acc[B];                                                                \
+        _Pragma("GCC unroll 16")                                                     \
+        for (int j = 0; j < B; ++j) acc[j] = 0.0f;                                   \
+        for (int k = 0; k < n; ++k) {                                                \
+            float a_val = rowA[k];                                                   \
+            const float *colV = V + (size_t)k * B;                                   \
+            _Pragma("GCC unroll 16")                                                 \
+            for (int j = 0; j < B; ++j) acc[j] += a_val * colV[j];                   \
+        }                                                                            \
+        _Pragma("GCC unroll 16")                                                     \
+        for (int j = 0; j < B; ++j) Y[(size_t)i * B + j] = acc[j];                   \
+    }                                                                                \
+}                                                                                    \
+static void matmul_AT_times_Y_b##B(const float *A, int lda, const float *Y, float *Z, int m, int n, int add) { \
+    for (int j = 0; j < n; ++j) {                                                    \
+        float acc[B];                                                                \
+        _Pragma("GCC unroll 16")                                                     \
+        for (int t = 0; t < B; ++t) acc[t] = 0.0f;                                   \
+        if (add) {                                                                   \
+            _Pragma("GCC unroll 16")                                                 \
+            for (int t = 0; t < B; ++t) acc[t] = Z[(size_t)j * B + t];               \
+        }                                                                            \
+        for (int i = 0; i < m; ++i) {                                                \
+            float a_val = A[(size_t)i * lda + j];                                    \
+            const float *rowY = Y + (size_t)i * B;                                   \
+            _Pragma("GCC unroll 16")                                                 \
+            for (int t = 0; t < B; ++t) acc[t] += a_val * rowY[t];                   \
+        }                                                                            \
+        _Pragma("GCC unroll 16")                                                     \
+        for (int t = 0; t < B; ++t) Z[(size_t)j * B + t] = acc[t];                   \
+    }                                                                                \
+}
+
+DEFINE_FIXED_B_KERNELS(1)  DEFINE_FIXED_B_KERNELS(2)  DEFINE_FIXED_B_KERNELS(3)
+DEFINE_FIXED_B_KERNELS(4)  DEFINE_FIXED_B_KERNELS(5)  DEFINE_FIXED_B_KERNELS(6)
+DEFINE_FIXED_B_KERNELS(7)  DEFINE_FIXED_B_KERNELS(8)  DEFINE_FIXED_B_KERNELS(9)
+DEFINE_FIXED_B_KERNELS(10) DEFINE_FIXED_B_KERNELS(11) DEFINE_FIXED_B_KERNELS(12)
+DEFINE_FIXED_B_KERNELS(13) DEFINE_FIXED_B_KERNELS(14) DEFINE_FIXED_B_KERNELS(15)
+DEFINE_FIXED_B_KERNELS(16)
+
+typedef void (*fixed_b_kernel)(const float *, const float *, float *, int, int);
+typedef void (*fixed_b_kernel_ld)(const float *, int, const float *, float *, int, int, int);
+
+static const fixed_b_kernel A_times_V_fixed[SVD_MAX_FIXED_B + 1] = {
+    NULL,
+    matmul_A_times_V_b1,  matmul_A_times_V_b2,  matmul_A_times_V_b3,  matmul_A_times_V_b4,
+    matmul_A_times_V_b5,  matmul_A_times_V_b6,  matmul_A_times_V_b7,  matmul_A_times_V_b8,
+    matmul_A_times_V_b9,  matmul_A_times_V_b10, matmul_A_times_V_b11, matmul_A_times_V_b12,
+    matmul_A_times_V_b13, matmul_A_times_V_b14, matmul_A_times_V_b15, matmul_A_times_V_b16
+};
+
+static const fixed_b_kernel_ld AT_times_Y_fixed[SVD_MAX_FIXED_B + 1] = {
+    NULL,
+    matmul_AT_times_Y_b1,  matmul_AT_times_Y_b2,  matmul_AT_times_Y_b3,  matmul_AT_times_Y_b4,
+    matmul_AT_times_Y_b5,  matmul_AT_times_Y_b6,  matmul_AT_times_Y_b7,  matmul_AT_times_Y_b8,
+    matmul_AT_times_Y_b9,  matmul_AT_times_Y_b10, matmul_AT_times_Y_b11, matmul_AT_times_Y_b12,
+    matmul_AT_times_Y_b13, matmul_AT_times_Y_b14, matmul_AT_times_Y_b15, matmul_AT_times_Y_b16
+};
+
+static void A_times_V_rows(const float *A, const float *V, float *Y, int m, int n, int b) {
+    if (b >= 1 && b <= SVD_MAX_FIXED_B)
+        A_times_V_fixed[b](A, V, Y, m, n);
+    else
+        matmul_A_times_V_any(A, V, Y, m, n, b);
+}
+
+/* A has leading dimension lda, so a range of columns can be passed in.
+   The rows go in blocks of AT_ROWS that carry the float sums on in Z: the
+   walk down a column then stays in cache, and since every column is still
+   summed from row 0 to row m-1 not a single addition changes */
+#define AT_ROWS 256
+
+static void AT_times_Y_rows(const float *A, int lda, const float *Y, float *Z, int m, int n, int b) {
+    for (int r0 = 0; r0 < m; r0 += AT_ROWS) {
+        int h = m - r0 < AT_ROWS ? m - r0 : AT_ROWS;
+        const float *Ab = A + (size_t)r0 * lda, *Yb = Y + (size_t)r0 * b;
+        if (b >= 1 && b <= SVD_MAX_FIXED_B)
+            AT_times_Y_fixed[b](Ab, lda, Yb, Z, h, n, r0 > 0);
+        else
+            matmul_AT_times_Y_any(Ab, lda, Yb, Z, h, n, b, r0 > 0);
+    }
+}
+
+/* Reproducible mode, per calling thread like threads_set */
+static _Thread_local int reproducible = 0;
+
+void svd_set_reproducible(int on) {
+    reproducible = on;
+}
+
+int svd_get_reproducible(void) {
+    return reproducible;
+}
+
+/* Y = A * V, picks the kernel for this b once per call.
+   Each thread does its own band of rows (see threads_row_range) */
+void matmul_A_times_V(const float *A, const float *V, float *Y, int m, int n, int b) {
+    int T = threads_count();
+    if (T > 1 && m >= 2 * T) {
+        #pragma omp parallel num_threads(T)
+        {
+            int i0, i1;
+            threads_row_range(m, threads_id(), threads_in_team(), &i0, &i1);
+            A_times_V_rows(A + (size_t)i0 * n, V, Y + (size_t)i0 * b, i1 - i0, n, b);
+        }
+        return;
+    }
+    A_times_V_rows(A, V, Y, m, n, b);
+}
+
+/* Z = Aᵀ * Y, picks the kernel for this b once per call.
+   Each thread works on the same band of rows of A as in matmul_A_times_V
+   (so it only reads memory it touched first) and the partial n×b results
+   are added up afterwards. The band edges move with the thread count and
+   so do the rounding errors of that sum.
+   In reproducible mode every thread takes a band of columns of A instead
+   and sums over all m rows itself, in the same order as one thread does,
+   so Z is bit for bit the single thread result for any thread count. */
+void matmul_AT_times_Y(const float *A, const float *Y, float *Z, int m, int n, int b) {
+    int T = threads_count();
+    if (reproducible) {
+        #pragma omp parallel num_threads(T) if (T > 1 && n >= 2 * T)
+        {
+            int j0, j1;
+            threads_row_range(n, threads_id(), threads_in_team(), &j0, &j1);
+            AT_times_Y_rows(A + j0, n, Y, Z + (size_t)j0 * b, m, j1 - j0, b);
+        }
+        return;
+    }
+    size_t nb = (size_t)n * b;
+    float *part = (T > 1 && m >= 2 * T) ? threads_scratch((size_t)T * nb) : NULL;
+    if (part) {
+        #pragma omp parallel num_threads(T)
+        {
+            int t = threads_id(), nt = threads_in_team(), i0, i1;
+            threads_row_range(m, t, nt, &i0, &i1);
+            AT_times_Y_rows(A + (size_t)i0 * n, n, Y + (size_t)i0 * b, part + (size_t)t * nb, i1 - i0, n, b);
+
+            #pragma omp barrier
+            #pragma omp for schedule(static)
+            for (long long x = 0; x < (long long)nb; ++x) {
+                float sum = 0.0f;
+                for (int q = 0; q < nt; ++q)
+                    sum += part[(size_t)q * nb + x];
+                Z[x] = sum;
+            }
+        }
+        return;
+    }
+    AT_times_Y_rows(A, n, Y, Z, m, n, b);
+}
+
 /*QR Orthogonalization using Gram-Schmidt*/
 
-/* This makes all columns of Z perpendicular (orthogonal) 
-   and also gives them length = 1 */
-void qr_modified_gram_schmidt(float *Z, int n, int b, int ld) {
-    for (int j = 0; j < b; ++j) {
-        // Subtract projection on all earlier columns
+/* Subtracts the projection of column j on the columns before it. If most
+   of the column cancels out (its length drops below 1/sqrt(2) of what it
+   was) rounding has left it tilted towards the earlier columns and the
+   projection is done once more ("twice is enough").
+   Adds the projections to R (may be NULL), returns the length² left. */
+static double project_column(float *Z, int n, int ld, int j, float *R, int b) {
+    double before = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double temp = Z[(size_t)i * ld + j];
+        before += temp * temp;
+    }
+    for (int pass = 0; pass < 2 && j > 0; ++pass) {
         for (int k = 0; k < j; ++k) {
             double dot_sum = 0.0;
             for (int i = 0; i < n; ++i)
@@ -81,17 +250,59 @@ void qr_modified_gram_schmidt(float *Z, int n, int b, int ld) {
             float proj = (float)dot_sum;
             for (int i = 0; i < n; ++i)
                 Z[(size_t)i * ld + j] -= proj * Z[(size_t)i * ld + k];
+            if (R) R[k * b + j] += proj;
         }
 
-        // Now divide by its own length to make length 1
-        double sq_sum = 0.0;
+        double after = 0.0;
         for (int i = 0; i < n; ++i) {
             double temp = Z[(size_t)i * ld + j];
-            sq_sum += temp * temp;
+            after += temp * temp;
+        }
+        if (after > 0.5 * before)
+            return after;
+        before = after;
+    }
+    return before;
+}
+
+/* This makes all columns of Z perpendicular (orthogonal) 
+   and also gives them length = 1 */
+void qr_modified_gram_schmidt(float *Z, int n, int b, int ld) {
+    qr_modified_gram_schmidt_r(Z, n, b, ld, NULL);
+}
+
+/* Same as above but also keeps the triangular factor, so that
+   Z(before) = Z(after) * R. R is b×b upper triangular (may be NULL) */
+void qr_modified_gram_schmidt_r(float *Z, int n, int b, int ld, float *R) {
+    if (R)
+        for (int i = 0; i < b * b; ++i) R[i] = 0.0f;
+
+    for (int j = 0; j < b; ++j) {
+        double orig = 0.0;
+        for (int i = 0; i < n; ++i) {
+            double temp = Z[(size_t)i * ld + j];
+            orig += temp * temp;
+        }
+        double sq_sum = project_column(Z, n, ld, j, R, b);
+        if (R) R[j * b + j] = (float)sqrt(sq_sum);
+
+        // Nothing but rounding left: the column lies in the span of the
+        // earlier ones (or was zero). Normalizing that noise would bring
+        // the earlier columns back, so a fixed pseudo random direction
+        // orthogonal to them takes its place (its R entry stays 0)
+        if (sq_sum <= 1e-10 * orig || sq_sum < 1e-30) {
+            unsigned int s = 2463534242u + 977u * (unsigned int)j;
+            for (int i = 0; i < n; ++i) {
+                s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+                Z[(size_t)i * ld + j] = (float)(s >> 8) / 16777216.0f - 0.5f;
+            }
+            sq_sum = project_column(Z, n, ld, j, NULL, b);
+            if (R) R[j * b + j] = 0.0f;
         }
-        sq_sum = sqrt(sq_sum);
 
-        float inv = (sq_sum == 0.0) ? 0.0f : (float)(1.0 / sq_sum);
+        // Now divide by its own length to make length 1
+        sq_sum = sqrt(sq_sum);
+        float inv = (sq_sum < 1e-30) ? 0.0f : (float)(1.0 / sq_sum); // 1/tiny would overflow to inf
         for (int i = 0; i < n; ++i)
             Z[(size_t)i * ld + j] *= inv;
     }
@@ -99,36 +310,374 @@ void qr_modified_gram_schmidt(float *Z, int n, int b, int ld) {
 
 /*Make new V vectors orthogonal to old ones*/
 
+/* C[k0..k1) = Lᵀ X for columns k0..k1 of L, summed over rows i0..i1 */
+static void block_project_rows(const float *X, int b, const float *L, int ldl,
+                               int k0, int k1, int i0, int i1, double *C) {
+    for (size_t t = (size_t)k0 * b; t < (size_t)k1 * b; ++t) C[t] = 0.0;
+    for (int i = i0; i < i1; ++i) {
+        const float *l = L + (size_t)i * ldl;
+        const float *x = X + (size_t)i * b;
+        for (int k = k0; k < k1; ++k) {
+            double lk = l[k];
+            double *c = C + (size_t)k * b;
+            for (int j = 0; j < b; ++j)
+                c[j] += lk * x[j];
+        }
+    }
+}
+
+/* One block Gram-Schmidt pass: X -= L (Lᵀ X) for n×b X and the nl columns
+   of L (leading dimension ldl). Both products walk L and X row by row,
+   so every row of L is read once per product instead of once per column
+   pair. C needs nl*b doubles, Cf nl*b floats.
+   C = Lᵀ X is threaded like matmul_AT_times_Y: with part (T*nl*b doubles)
+   every thread sums its band of rows and the partial C are added up in
+   thread order, in reproducible mode every thread takes a band of columns
+   of L and sums over all n rows, which is the one thread result. */
+static void block_project_pass(float *X, int n, int b, const float *L, int ldl, int nl,
+                               double *C, float *Cf, double *part) {
+    size_t nb = (size_t)nl * b;
+#ifdef _OPENMP
+    int T = threads_count();
+#endif
+
+    // C = Lᵀ X
+    if (part) {
+        #pragma omp parallel num_threads(T)
+        {
+            int t = threads_id(), nt = threads_in_team(), i0, i1;
+            threads_row_range(n, t, nt, &i0, &i1);
+            block_project_rows(X, b, L, ldl, 0, nl, i0, i1, part + (size_t)t * nb);
+
+            #pragma omp barrier
+            #pragma omp for schedule(static)
+            for (long long x = 0; x < (long long)nb; ++x) {
+                double sum = 0.0;
+                for (int q = 0; q < nt; ++q)
+                    sum += part[(size_t)q * nb + x];
+                C[x] = sum;
+                Cf[x] = (float)sum;
+            }
+        }
+    } else {
+        #pragma omp parallel num_threads(T) if (T > 1 && nl >= 2 * T)
+        {
+            int k0, k1;
+            threads_row_range(nl, threads_id(), threads_in_team(), &k0, &k1);
+            block_project_rows(X, b, L, ldl, k0, k1, 0, n, C);
+            for (size_t t = (size_t)k0 * b; t < (size_t)k1 * b; ++t) Cf[t] = (float)C[t];
+        }
+    }
+
+    // X = X - L C, rows are independent so they are split between threads
+    #pragma omp parallel for num_threads(T) schedule(static) if (T > 1 && n >= 2 * T)
+    for (int i = 0; i < n; ++i) {
+        const float *l = L + (size_t)i * ldl;
+        float *x = X + (size_t)i * b;
+        for (int k = 0; k < nl; ++k) {
+            float lk = l[k];
+            const float *c = Cf + (size_t)k * b;
+            #pragma omp simd
+            for (int j = 0; j < b; ++j)
+                x[j] -= lk * c[j];
+        }
+    }
+}
+
+/* Runs the pass 'passes' times. Returns -1 if the scratch could not be allocated */
+static int block_project(float *X, int n, int b, const float *L, int ldl, int nl, int passes) {
+    if (nl <= 0) return 0;
+    size_t nb = (size_t)nl * b;
+    int T = threads_count();
+    size_t parts = (!reproducible && T > 1 && n >= 2 * T) ? (size_t)T * nb : 0;
+    double C_small[1024];
+    float Cf_small[1024];
+    double *C = C_small, *part = NULL;
+    float *Cf = Cf_small;
+    void *heap = NULL;
+    if (nb > 1024 || parts > 0) {
+        heap = malloc((nb + parts) * sizeof(double) + nb * sizeof(float));
+        if (!heap) return -1;
+        C = (double*)heap;
+        part = parts > 0 ? C + nb : NULL;
+        Cf = (float*)(C + nb + parts);
+    }
+    for (int p = 0; p < passes; ++p)
+        block_project_pass(X, n, b, L, ldl, nl, C, Cf, part);
+    free(heap);
+    return 0;
+}
+
 /* This removes any part of current V that lies along previous V
-   so that all vectors stay independent */
-void orthogonalize_against_prev(float *V, int n, int b,
-                                float *PrevV, int prev_cols, int ld_prev) {
-    if (prev_cols <= 0) return;
+   so that all vectors stay independent.
+   Block classical Gram-Schmidt run twice (BCGS2): one pass loses
+   orthogonality when V is close to the span of PrevV, the second pass
+   puts it back to rounding level. The block is then made orthonormal.
+   Returns -1 (V untouched) if the scratch could not be allocated */
+int orthogonalize_against_prev(float *V, int n, int b,
+                               float *PrevV, int prev_cols, int ld_prev) {
+    if (prev_cols <= 0) return 0;
+
+    if (block_project(V, n, b, PrevV, ld_prev, prev_cols, 2) != 0) return -1;
+    qr_modified_gram_schmidt(V, n, b, b);
+    return 0;
+}
+
+/*Full SVD of a small matrix*/
+
+/* One-sided Jacobi SVD for small dense matrices (a few dozen rows/cols).
+   M is rows×cols, p = min(rows, cols).
+   Outputs U (rows×p), S (p values, largest first) and V (cols×p) */
+void small_svd_jacobi(const float *M, int rows, int cols,
+                      float *U, float *S, float *V) {
+    // Work on the taller orientation so that columns get rotated
+    int trans = rows < cols;
+    int r = trans ? cols : rows;
+    int c = trans ? rows : cols;
+
+    double *W = (double*)malloc((size_t)r * c * sizeof(double));
+    double *R = (double*)calloc((size_t)c * c, sizeof(double));
+    int *order = (int*)malloc((size_t)c * sizeof(int));
+    double *sv = (double*)malloc((size_t)c * sizeof(double));
+    if (!W || !R || !order || !sv) {
+        free(W); free(R); free(order); free(sv);
+        return;
+    }
+
+    for (int i = 0; i < r; ++i)
+        for (int j = 0; j < c; ++j)
+            W[(size_t)i * c + j] = trans ? M[(size_t)j * cols + i] : M[(size_t)i * cols + j];
+    for (int j = 0; j < c; ++j)
+        R[(size_t)j * c + j] = 1.0;
+
+    // Rotate pairs of columns until all of them are perpendicular
+    for (int sweep = 0; sweep < 60; ++sweep) {
+        int rotated = 0;
+        for (int p = 0; p < c - 1; ++p) {
+            for (int q = p + 1; q < c; ++q) {
+                double alpha = 0.0, beta = 0.0, gamma = 0.0;
+                for (int i = 0; i < r; ++i) {
+                    double wp = W[(size_t)i * c + p], wq = W[(size_t)i * c + q];
+                    alpha += wp * wp;
+                    beta += wq * wq;
+                    gamma += wp * wq;
+                }
+                if (fabs(gamma) <= 1e-15 * sqrt(alpha * beta) || gamma == 0.0)
+                    continue;
+                rotated = 1;
+
+                double zeta = (beta - alpha) / (2.0 * gamma);
+                double t = (zeta >= 0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                double cs = 1.0 / sqrt(1.0 + t * t), sn = cs * t;
+
+                for (int i = 0; i < r; ++i) {
+                    double wp = W[(size_t)i * c + p], wq = W[(size_t)i * c + q];
+                    W[(size_t)i * c + p] = cs * wp - sn * wq;
+                    W[(size_t)i * c + q] = sn * wp + cs * wq;
+                }
+                for (int i = 0; i < c; ++i) {
+                    double rp = R[(size_t)i * c + p], rq = R[(size_t)i * c + q];
+                    R[(size_t)i * c + p] = cs * rp - sn * rq;
+                    R[(size_t)i * c + q] = sn * rp + cs * rq;
+                }
+            }
+        }
+        if (!rotated) break;
+    }
+
+    // Column lengths are the singular values, sort them largest first
+    for (int j = 0; j < c; ++j) {
+        double sum = 0.0;
+        for (int i = 0; i < r; ++i)
+            sum += W[(size_t)i * c + j] * W[(size_t)i * c + j];
+        sv[j] = sqrt(sum);
+        order[j] = j;
+    }
+    for (int a = 1; a < c; ++a) {
+        int key = order[a], b = a - 1;
+        while (b >= 0 && sv[order[b]] < sv[key]) {
+            order[b + 1] = order[b];
+            b--;
+        }
+        order[b + 1] = key;
+    }
+
+    // Left vectors are the normalized columns of W, right vectors come from R
+    float *left = trans ? V : U;
+    float *right = trans ? U : V;
+    for (int t = 0; t < c; ++t) {
+        int j = order[t];
+        double inv = sv[j] > 1e-30 ? 1.0 / sv[j] : 0.0;
+        S[t] = (float)sv[j];
+        for (int i = 0; i < r; ++i)
+            left[(size_t)i * c + t] = (float)(W[(size_t)i * c + j] * inv);
+        for (int i = 0; i < c; ++i)
+            right[(size_t)i * c + t] = (float)R[(size_t)i * c + j];
+    }
 
+    free(W); free(R); free(order); free(sv);
+}
+
+/*Convergence test*/
+
+/* After QR of Z = AᵀA V the diagonal of R holds the Ritz values
+   (estimates of sigma²) of the current block. They do not care about
+   sign flips of the vectors and need no extra pass over V.
+   vals[j * stride] is the j-th value (stride b+1 walks down the diagonal of R).
+   Returns 1 when every value moved less than tol (relative) since the
+   last call. ritz_prev keeps the b values between calls */
+int ritz_converged(const float *vals, int stride, int b, float *ritz_prev, int first, float tol) {
+    int done = !first;
     for (int j = 0; j < b; ++j) {
-        for (int k = 0; k < prev_cols; ++k) {
-            double sum = 0.0;
-            for (int i = 0; i < n; ++i)
-                sum += (double)PrevV[(size_t)i * ld_prev + k] * V[(size_t)i * b + j];
+        float r = vals[(size_t)j * stride];
+        if (fabsf(r - ritz_prev[j]) > tol * fabsf(r))
+            done = 0;
+        ritz_prev[j] = r;
+    }
+    return done;
+}
 
-            float proj = (float)sum;
-            for (int i = 0; i < n; ++i)
-                V[(size_t)i * b + j] -= proj * PrevV[(size_t)i * ld_prev + k];
+/*Rank-b update*/
+
+#define UPDATE_TILE 256   // columns per tile, b×256 floats of Vᵀ stay in L1
+
+/* C += U diag(S) Vᵀ and R -= U diag(S) Vᵀ in one sweep.
+   U is m×b, V is n×b (both leading dimension b), S has b values (NULL
+   means all ones), C or R may be NULL. Vᵀ is scaled and transposed once,
+   then every thread walks its own band of rows (the same bands as the
+   matmul kernels) one column tile at a time, so each element of C and R
+   is read and written once for the whole block.
+   work holds the b×n scaled Vᵀ. If it is NULL the buffer is allocated
+   here; returns -1 (C and R untouched) when that fails. */
+int rank_update(float *C, float *R, int m, int n,
+                const float *U, const float *S, const float *V, int b, float *work) {
+    float *VT = work ? work : (float*)malloc((size_t)b * n * sizeof(float));
+    if (!VT) return -1;
+    for (int k = 0; k < n; ++k)
+        for (int j = 0; j < b; ++j)
+            VT[(size_t)j * n + k] = V[(size_t)k * b + j] * (S ? S[j] : 1.0f);
+
+#ifdef _OPENMP
+    int T = threads_count();
+#endif
+    #pragma omp parallel num_threads(T) if (T > 1 && m >= 2 * T)
+    {
+        int i0, i1;
+        threads_row_range(m, threads_id(), threads_in_team(), &i0, &i1);
+        float tile[UPDATE_TILE];
+
+        for (int c0 = 0; c0 < n; c0 += UPDATE_TILE) {
+            int w = n - c0 < UPDATE_TILE ? n - c0 : UPDATE_TILE;
+            for (int i = i0; i < i1; ++i) {
+                const float *u = U + (size_t)i * b;
+
+                // tile = row i of U diag(S) Vᵀ, columns c0 .. c0+w
+                #pragma omp simd
+                for (int c = 0; c < w; ++c) tile[c] = 0.0f;
+                for (int j = 0; j < b; ++j) {
+                    float uj = u[j];
+                    const float *vt = VT + (size_t)j * n + c0;
+                    #pragma omp simd
+                    for (int c = 0; c < w; ++c)
+                        tile[c] += uj * vt[c];
+                }
+
+                if (C) {
+                    float *crow = C + (size_t)i * n + c0;
+                    #pragma omp simd
+                    for (int c = 0; c < w; ++c) crow[c] += tile[c];
+                }
+                if (R) {
+                    float *rrow = R + (size_t)i * n + c0;
+                    #pragma omp simd
+                    for (int c = 0; c < w; ++c) rrow[c] -= tile[c];
+                }
+            }
         }
-        // Finally normalize this column
-        normalize_vector(&V[j], n);
     }
+    if (VT != work)
+        free(VT);
+    return 0;
+}
+
+/*Chebyshev filter*/
+
+/* X -= L (Lᵀ X) for X n×b and nl orthonormal columns of L, -1 if out of memory */
+static int project_out(float *X, int n, int b, const float *L, int ldl, int nl) {
+    return block_project(X, n, b, L, ldl, nl, 1);
+}
+
+/* X_out = p(AᵀA) X where p is the degree d Chebyshev polynomial that stays
+   small on [0, cut] and is scaled to about 1 at top. Eigenvalues of AᵀA
+   above cut (the wanted ones) grow much faster than with d plain power
+   steps, which helps when the spectrum is flat.
+   Y (m×b) is A*X on entry and gets overwritten. X, W, Z are n×b buffers,
+   all three are used as scratch and the result pointer is one of them.
+   The nl locked vectors L (leading dimension ldl) are projected out after
+   every AᵀA product, otherwise rounding errors along them (much bigger
+   eigenvalues than top) would blow up and swamp X. Returns NULL if that
+   projection runs out of memory. */
+static float* chebyshev_filter(const float *A, int m, int n, int b, int degree,
+                               double cut, double top,
+                               float *X, float *Y, float *W, float *Z,
+                               const float *L, int ldl, int nl) {
+    double e = cut / 2.0, c = cut / 2.0;
+    double sigma1 = e / (top - c), sigma = sigma1;
+    size_t count = (size_t)n * b;
+
+    // First term: X1 = (AᵀA X - c X) * sigma1 / e
+    matmul_AT_times_Y(A, Y, Z, m, n, b);
+    if (project_out(Z, n, b, L, ldl, nl) != 0) return NULL;
+    float s1 = (float)(sigma1 / e), cf = (float)c;
+    for (size_t i = 0; i < count; ++i)
+        Z[i] = s1 * (Z[i] - cf * X[i]);
+
+    // Three term recurrence X_{k+1} = 2 s'/e (AᵀA X_k - c X_k) - s s' X_{k-1}
+    float *prev = X, *cur = Z, *next = W;
+    for (int k = 2; k <= degree; ++k) {
+        double sigma_new = 1.0 / (2.0 / sigma1 - sigma);
+        float a = (float)(2.0 * sigma_new / e), g = (float)(sigma * sigma_new);
+
+        matmul_A_times_V(A, cur, Y, m, n, b);
+        matmul_AT_times_Y(A, Y, next, m, n, b);
+        if (project_out(next, n, b, L, ldl, nl) != 0) return NULL;
+        for (size_t i = 0; i < count; ++i)
+            next[i] = a * (next[i] - cf * cur[i]) - g * prev[i];
+
+        // Rotate buffers, the oldest one is free for the next term
+        float *old = prev;
+        prev = cur; cur = next; next = old;
+        sigma = sigma_new;
+    }
+    return cur;
+}
+
+/* The filter value at top over the value at cut is T_d(x_top). A vector
+   near cut ends up that many times smaller than one near top, and in float
+   it is lost once that ratio nears 1e7, so the degree is lowered until the
+   growth stays below this */
+#define CHEB_MAX_GROWTH 1e3
+
+static int chebyshev_degree(int degree, double cut, double top) {
+    if (cut <= 0.0 || top <= cut * (1.0 + 1e-6)) return 1;
+    double x = (top - cut / 2.0) / (cut / 2.0);
+    int d = degree;
+    while (d > 1 && cosh(d * acosh(x)) > CHEB_MAX_GROWTH) d--;
+    return d;
 }
 
 /* Main Block Power Iteration for SVD */
 
-/* This function performs one block step of SVD
-   It updates the approximation and removes that part from residual */
-void svd_block_step(float *A_residual, int m, int n, int b,
-                    float *A_approx,
-                    float *tempV, float *tempY, float *tempZ,
-                    int max_iter, float tol,
-                    const float *PrevV, int prev_cols, int ld_prev)
+/* Shared body of svd_block_step and svd_block_step_chebyshev.
+   degree <= 1 (or tempW == NULL) means plain power steps.
+   Returns the number of iterations that changed V (max_iter if the Ritz
+   values did not settle), or -1 with A_res and A_approx untouched if
+   the scratch could not be allocated */
+static int block_step(float *A_residual, int m, int n, int b,
+                      float *A_approx,
+                      float *tempV, float *tempY, float *tempZ, float *tempW,
+                      int max_iter, float tol,
+                      const float *PrevV, int prev_cols, int ld_prev, int degree)
 {
     // First we give V some small random-like values
     for (int i = 0; i < n; ++i)
@@ -136,40 +685,104 @@ void svd_block_step(float *A_residual, int m, int n, int b,
             tempV[(size_t)i * b + j] = 1.0f + 1e-3f * (float)(j + (i % 7));
 
     // Make these V vectors orthogonal to earlier found ones
-    orthogonalize_against_prev(tempV, n, b, (float*)PrevV, prev_cols, ld_prev);
+    if (orthogonalize_against_prev(tempV, n, b, (float*)PrevV, prev_cols, ld_prev) != 0)
+        return -1;
+
+    // R factor of the QR step, its diagonal gives the Ritz values
+    float R_small[SVD_MAX_FIXED_B * SVD_MAX_FIXED_B + 2 * SVD_MAX_FIXED_B];
+    float *R = R_small;
+    if (b > SVD_MAX_FIXED_B) {
+        R = (float*)malloc(((size_t)b * b + 2 * b) * sizeof(float));
+        if (!R) return -1;
+    }
+    float *ritz_prev = R + (size_t)b * b;
+    float *ritz = ritz_prev + b;
+    int filtered = degree > 1 && tempW != NULL;
 
-    // Temporary copy of V to check when it stops changing
-    float *V_old = (float*)malloc((size_t)n * b * sizeof(float));
-    if (!V_old) return;
+    // V and Z swap roles every iteration instead of copying Z into V
+    float *V = tempV, *Z = tempZ, *W = tempW;  // W is only used by the filter
+    int steps = 0;
 
     for (int iter = 0; iter < max_iter; ++iter) {
-        memcpy(V_old, tempV, n * b * sizeof(float));
-
         // Step 1: Y = A * V
-        matmul_A_times_V(A_residual, tempV, tempY, m, n, b);
+        matmul_A_times_V(A_residual, V, tempY, m, n, b);
+
+        if (filtered && iter > 0) {
+            // V is orthonormal here, so the column lengths² of Y are the Ritz values
+            for (int j = 0; j < b; ++j) {
+                double sum = 0.0;
+                for (int i = 0; i < m; ++i) {
+                    double val = tempY[(size_t)i * b + j];
+                    sum += val * val;
+                }
+                ritz[j] = (float)sum;
+            }
+
+            // Leading columns whose Ritz value has settled are locked (left out of the filter)
+            int lock = 0;
+            if (iter > 1)
+                while (lock < b && fabsf(ritz[lock] - ritz_prev[lock]) <= tol * fabsf(ritz[lock]))
+                    lock++;
+            if (ritz_converged(ritz, 1, b, ritz_prev, iter == 1, tol))
+                break;
+
+            // Step 2: filter the active columns with [0, smallest Ritz value] damped
+            int ba = b - lock;
+            double cut = ritz[lock], top = ritz[lock];
+            for (int j = lock + 1; j < b; ++j) {
+                if (ritz[j] < cut) cut = ritz[j];
+                if (ritz[j] > top) top = ritz[j];
+            }
+            int d = chebyshev_degree(degree, cut, top);
+            if (d > 1) {
+                // Pack the active columns of V and Y together (Y in place)
+                float *X = W, *S1 = W + (size_t)n * b;
+                for (int i = 0; i < n; ++i)
+                    for (int t = 0; t < ba; ++t)
+                        X[(size_t)i * ba + t] = V[(size_t)i * b + lock + t];
+                for (int i = 0; i < m; ++i)
+                    for (int t = 0; t < ba; ++t)
+                        tempY[(size_t)i * ba + t] = tempY[(size_t)i * b + lock + t];
+
+                float *out = chebyshev_filter(A_residual, m, n, ba, d, cut, top,
+                                              X, tempY, S1, Z, V, b, lock);
+                if (!out) {
+                    if (R != R_small) free(R);
+                    return -1;
+                }
+                for (int i = 0; i < n; ++i)
+                    for (int t = 0; t < ba; ++t)
+                        V[(size_t)i * b + lock + t] = out[(size_t)i * ba + t];
+
+                // Step 3: orthonormalize, locked columns stay first
+                qr_modified_gram_schmidt(V, n, b, b);
+                steps++;
+                continue;
+            }
+        }
 
         // Step 2: Z = Aᵀ * Y
-        matmul_AT_times_Y(A_residual, tempY, tempZ, m, n, b);
+        matmul_AT_times_Y(A_residual, tempY, Z, m, n, b);
 
         // Step 3: Make Z orthogonal to get new V
-        qr_modified_gram_schmidt(tempZ, n, b, b);
-        memcpy(tempV, tempZ, n * b * sizeof(float));
+        qr_modified_gram_schmidt_r(Z, n, b, b, R);
+        float *swap = V; V = Z; Z = swap;
+        steps++;
 
-        // Step 4: Check how much V changed from last time
-        double diff_sum = 0.0;
-        for (int i = 0; i < n * b; ++i) {
-            double d = (double)tempV[i] - (double)V_old[i];
-            diff_sum += d * d;
-        }
-        if (sqrt(diff_sum) < tol)
-            break; // if change is small, we can stop
+        // Step 4: Stop when the Ritz values stop changing
+        if (!filtered && ritz_converged(R, b + 1, b, ritz_prev, iter == 0, tol))
+            break;
     }
 
-    free(V_old);
+    // The caller expects the vectors in tempV
+    if (V != tempV)
+        memcpy(tempV, V, (size_t)n * b * sizeof(float));
 
-    // Now make the low-rank update in A_approx and remove that from A_residual
+    // Now make the low-rank update in A_approx and remove that from A_residual.
+    // Y = A V = U Σ, so the update is Y Vᵀ for every column with a non zero sigma
     matmul_A_times_V(A_residual, tempV, tempY, m, n, b);
 
+    float *keep = ritz; // b floats that are free again
     for (int j = 0; j < b; ++j) {
         double sigma_sqrs = 0.0;
 
@@ -178,22 +791,44 @@ void svd_block_step(float *A_residual, int m, int n, int b,
             double val = tempY[(size_t)i * b + j];
             sigma_sqrs += val * val;
         }
+        keep[j] = sqrt(sigma_sqrs) < 1e-12 ? 0.0f : 1.0f;
+    }
+    // tempZ (n×b) is free again and holds the scaled Vᵀ
+    rank_update(A_approx, A_residual, m, n, tempY, keep, tempV, b, tempZ);
+    if (R != R_small)
+        free(R);
+    return steps;
+}
 
-        double sigma = sqrt(sigma_sqrs);
-        if (sigma < 1e-12)
-            continue;
+/* This function performs one block step of SVD
+   It updates the approximation and removes that part from residual.
+   iters (may be NULL) gets the number of power iterations it took.
+   Returns 0, or -1 (nothing updated) when it runs out of memory */
+int svd_block_step(float *A_residual, int m, int n, int b,
+                   float *A_approx,
+                   float *tempV, float *tempY, float *tempZ,
+                   int max_iter, float tol,
+                   const float *PrevV, int prev_cols, int ld_prev, int *iters)
+{
+    int steps = block_step(A_residual, m, n, b, A_approx, tempV, tempY, tempZ, NULL,
+                           max_iter, tol, PrevV, prev_cols, ld_prev, 1);
+    if (steps < 0) return -1;
+    if (iters) *iters = steps;
+    return 0;
+}
 
-        // Update both A_approx and A_residual
-        for (int i = 0; i < m; ++i) {
-            float u_i = tempY[(size_t)i * b + j] / (float)sigma;
-            float su_i = (float)sigma * u_i;
-
-            for (int k = 0; k < n; ++k) {
-                float v_kj = tempV[(size_t)k * b + j];
-                float up = su_i * v_kj;
-                A_approx[(size_t)i * n + k] += up;   // adding this part to the approximation
-                A_residual[(size_t)i * n + k] -= up; // removing same part from residual
-            }
-        }
-    }
+/* Same as svd_block_step but every iteration applies a degree 'degree'
+   Chebyshev filter instead of a single AᵀA step.
+   tempW needs room for n×2b floats */
+int svd_block_step_chebyshev(float *A_residual, int m, int n, int b,
+                             float *A_approx,
+                             float *tempV, float *tempY, float *tempZ, float *tempW,
+                             int max_iter, float tol,
+                             const float *PrevV, int prev_cols, int ld_prev, int degree, int *iters)
+{
+    int steps = block_step(A_residual, m, n, b, A_approx, tempV, tempY, tempZ, tempW,
+                           max_iter, tol, PrevV, prev_cols, ld_prev, degree);
+    if (steps < 0) return -1;
+    if (iters) *iters = steps;
+    return 0;
 }
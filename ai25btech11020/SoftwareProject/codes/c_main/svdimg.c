@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/workspace.h"
+#include "../c_libs/threads.h"
+#include "../c_libs/svdimg.h"
+
+/*Library interface*/
+
+struct svdimg_ctx {
+    svdimg_params p;
+    workspace ws;
+    int last_rank;
+};
+
+void svdimg_default_params(svdimg_params *p) {
+    p->threads = 0;
+    p->cheb = 1;
+    p->block = SVD_MAX_FIXED_B;
+    p->max_iter = 100;
+    p->tol = 1e-5f;
+    p->hugepages = 0;
+    p->max_error = 0.0;
+    p->reproducible = 0;
+}
+
+void svdimg_set_params(svdimg_ctx *ctx, const svdimg_params *p) {
+    if (p) ctx->p = *p;
+    else svdimg_default_params(&ctx->p);
+    if (ctx->p.block < 1 || ctx->p.block > SVD_MAX_FIXED_B) ctx->p.block = SVD_MAX_FIXED_B;
+    if (ctx->p.cheb < 1) ctx->p.cheb = 1;
+    if (ctx->p.max_iter < 1) ctx->p.max_iter = 100;
+}
+
+const svdimg_params* svdimg_get_params(const svdimg_ctx *ctx) {
+    return &ctx->p;
+}
+
+int svdimg_last_rank(const svdimg_ctx *ctx) {
+    return ctx->last_rank;
+}
+
+svdimg_ctx* svdimg_create(const svdimg_params *p) {
+    svdimg_ctx *ctx = (svdimg_ctx*)calloc(1, sizeof(svdimg_ctx));
+    if (!ctx) return NULL;
+    svdimg_set_params(ctx, p);
+    return ctx;
+}
+
+void svdimg_destroy(svdimg_ctx *ctx) {
+    if (!ctx) return;
+    workspace_free(&ctx->ws);
+    free(ctx);
+}
+
+/* The workspace only ever grows, so a service that sees the same sizes
+   again and again stops allocating after the first request */
+int svdimg_reserve(svdimg_ctx *ctx, int m, int n, int k) {
+    if (!ctx || m < 1 || n < 1 || k < 1) return SVDIMG_EINVAL;
+    size_t bytes = workspace_bytes_for_job(m, n, k, ctx->p.block, ctx->p.cheb > 1);
+    if (ctx->ws.base && bytes <= ctx->ws.size) return SVDIMG_OK;
+    workspace_free(&ctx->ws);
+    if (workspace_init(&ctx->ws, bytes, ctx->p.hugepages) != 0) {
+        memset(&ctx->ws, 0, sizeof(ctx->ws));
+        return SVDIMG_ENOMEM;
+    }
+    return SVDIMG_OK;
+}
+
+/* Takes the buffers of one job from the workspace. A_app may already be
+   given (the caller's output when it is contiguous). */
+typedef struct {
+    float *A_res, *A_app, *V, *Y, *Z, *W, *PrevV;
+} svdimg_job;
+
+static int start_job(svdimg_ctx *ctx, int m, int n, int k, float *A_app, svdimg_job *j) {
+    int rc = svdimg_reserve(ctx, m, n, k);
+    if (rc != SVDIMG_OK) return rc;
+    threads_set(ctx->p.threads);
+    svd_set_reproducible(ctx->p.reproducible);
+    workspace *ws = &ctx->ws;
+    int b = ctx->p.block;
+    workspace_rewind(ws, 0);
+    j->A_res = (float*)workspace_alloc(ws, (size_t)m * n * sizeof(float));
+    j->A_app = A_app ? A_app : (float*)workspace_alloc(ws, (size_t)m * n * sizeof(float));
+    j->V = (float*)workspace_alloc(ws, (size_t)n * b * sizeof(float));
+    j->Y = (float*)workspace_alloc(ws, (size_t)m * b * sizeof(float));
+    j->Z = (float*)workspace_alloc(ws, (size_t)n * b * sizeof(float));
+    j->W = ctx->p.cheb > 1 ? (float*)workspace_alloc(ws, (size_t)n * 2 * b * sizeof(float)) : NULL;
+    j->PrevV = (float*)workspace_alloc(ws, (size_t)n * k * sizeof(float));
+    if (!j->A_res || !j->A_app || !j->V || !j->Y || !j->Z || (ctx->p.cheb > 1 && !j->W) || !j->PrevV)
+        return SVDIMG_ENOMEM;
+    first_touch_zero(j->A_app, m, n);
+    memset(j->PrevV, 0, (size_t)n * k * sizeof(float));
+    return SVDIMG_OK;
+}
+
+/* Block SVD as in main.c. A_res must hold the image and energy its ||A||²;
+   when U is given the factors are written out block by block (U normalised,
+   S = column length). With max_error the error left is energy minus the
+   sigma² found so far, the loop stops as soon as it is small enough.
+   Returns SVDIMG_OK or SVDIMG_ENOMEM if a block step ran out of memory. */
+static int run_job(svdimg_ctx *ctx, svdimg_job *j, int m, int n, int k, double energy,
+                    float *U, int ldu, float *S, float *V, int ldv) {
+    double target = ctx->p.max_error > 0.0 ? ctx->p.max_error * ctx->p.max_error * 1e-4 * energy : -1.0;
+    double left = energy;
+    int prev_cols = 0;
+    while (prev_cols < k && left > target) {
+        int b = k - prev_cols < ctx->p.block ? k - prev_cols : ctx->p.block;
+        int rc = j->W ? svd_block_step_chebyshev(j->A_res, m, n, b, j->A_app, j->V, j->Y, j->Z, j->W,
+                                                 ctx->p.max_iter, ctx->p.tol, j->PrevV, prev_cols, k, ctx->p.cheb, NULL)
+                      : svd_block_step(j->A_res, m, n, b, j->A_app, j->V, j->Y, j->Z,
+                                       ctx->p.max_iter, ctx->p.tol, j->PrevV, prev_cols, k, NULL);
+        if (rc != 0) {
+            ctx->last_rank = prev_cols;
+            return SVDIMG_ENOMEM;
+        }
+
+        for (int c = 0; c < b; c++) {
+            for (int i = 0; i < n; i++)
+                j->PrevV[(size_t)i * k + prev_cols + c] = j->V[(size_t)i * b + c];
+            double sq = 0.0;
+            for (int i = 0; i < m; i++) {
+                double y = j->Y[(size_t)i * b + c];
+                sq += y * y;
+            }
+            left -= sq;
+            if (!U) continue;
+            double sigma = sqrt(sq);
+            float inv = sigma < 1e-12 ? 0.0f : (float)(1.0 / sigma);
+            S[prev_cols + c] = sigma < 1e-12 ? 0.0f : (float)sigma;
+            for (int i = 0; i < m; i++)
+                U[(size_t)i * ldu + prev_cols + c] = j->Y[(size_t)i * b + c] * inv;
+            for (int i = 0; i < n; i++)
+                V[(size_t)i * ldv + prev_cols + c] = j->V[(size_t)i * b + c];
+        }
+        prev_cols += b;
+    }
+    ctx->last_rank = prev_cols;
+    return SVDIMG_OK;
+}
+
+static int bad_args(const svdimg_ctx *ctx, const void *img, int m, int n, size_t stride, int k) {
+    return !ctx || !img || m < 1 || n < 1 || stride < (size_t)n || k < 1 || k > m || k > n;
+}
+
+/* Sums over the image are taken over SVDIMG_CHUNKS fixed row ranges that
+   are added in order afterwards, so the numbers do not change with the
+   thread count */
+#define SVDIMG_CHUNKS 64
+
+static double sum_parts(const double *part) {
+    double total = 0.0;
+    for (int q = 0; q < SVDIMG_CHUNKS; q++) total += part[q];
+    return total;
+}
+
+/* Strided rows into A_res, each band written by the thread that works on it
+   later, and returns ||A||² */
+static double load_f32(float *A_res, const float *img, int m, int n, size_t stride) {
+    double part[SVDIMG_CHUNKS];
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < SVDIMG_CHUNKS; q++) {
+        int i0, i1;
+        threads_row_range(m, q, SVDIMG_CHUNKS, &i0, &i1);
+        double energy = 0.0;
+        for (int i = i0; i < i1; i++) {
+            const float *src = img + (size_t)i * stride;
+            float *dst = A_res + (size_t)i * n;
+            for (int c = 0; c < n; c++) {
+                dst[c] = src[c];
+                energy += (double)src[c] * src[c];
+            }
+        }
+        part[q] = energy;
+    }
+    return sum_parts(part);
+}
+
+static double load_u8(float *A_res, const unsigned char *img, int m, int n, size_t stride) {
+    double part[SVDIMG_CHUNKS];
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < SVDIMG_CHUNKS; q++) {
+        int i0, i1;
+        threads_row_range(m, q, SVDIMG_CHUNKS, &i0, &i1);
+        double energy = 0.0;
+        for (int i = i0; i < i1; i++) {
+            const unsigned char *src = img + (size_t)i * stride;
+            float *dst = A_res + (size_t)i * n;
+            for (int c = 0; c < n; c++) {
+                dst[c] = (float)src[c];
+                energy += (double)src[c] * src[c];
+            }
+        }
+        part[q] = energy;
+    }
+    return sum_parts(part);
+}
+
+int svdimg_factor(svdimg_ctx *ctx, const float *img, int m, int n, size_t stride, int k,
+                  float *U, int ldu, float *S, float *V, int ldv) {
+    if (bad_args(ctx, img, m, n, stride, k) || !U || !S || !V || ldu < k || ldv < k)
+        return SVDIMG_EINVAL;
+    svdimg_job j;
+    int rc = start_job(ctx, m, n, k, NULL, &j);
+    if (rc != SVDIMG_OK) return rc;
+    double energy = load_f32(j.A_res, img, m, n, stride);
+    return run_job(ctx, &j, m, n, k, energy, U, ldu, S, V, ldv);
+}
+
+int svdimg_reconstruct(svdimg_ctx *ctx, const float *img, int m, int n, size_t stride, int k,
+                       float *out, size_t out_stride, double *error) {
+    if (bad_args(ctx, img, m, n, stride, k) || !out || out_stride < (size_t)n)
+        return SVDIMG_EINVAL;
+    // A contiguous output is used as A_app directly, no copy at the end
+    int direct = out_stride == (size_t)n;
+    svdimg_job j;
+    int rc = start_job(ctx, m, n, k, direct ? out : NULL, &j);
+    if (rc != SVDIMG_OK) return rc;
+    double energy = load_f32(j.A_res, img, m, n, stride);
+    rc = run_job(ctx, &j, m, n, k, energy, NULL, 0, NULL, NULL, 0);
+    if (rc != SVDIMG_OK) return rc;
+
+    double part_num[SVDIMG_CHUNKS], part_den[SVDIMG_CHUNKS];
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < SVDIMG_CHUNKS; q++) {
+        int i0, i1;
+        threads_row_range(m, q, SVDIMG_CHUNKS, &i0, &i1);
+        double num = 0.0, den = 0.0;
+        for (int i = i0; i < i1; i++) {
+            const float *a = img + (size_t)i * stride;
+            const float *ak = j.A_app + (size_t)i * n;
+            for (int c = 0; c < n; c++) {
+                double d = (double)a[c] - ak[c];
+                num += d * d;
+                den += (double)a[c] * a[c];
+            }
+            if (!direct) memcpy(out + (size_t)i * out_stride, ak, (size_t)n * sizeof(float));
+        }
+        part_num[q] = num;
+        part_den[q] = den;
+    }
+    double num = sum_parts(part_num), den = sum_parts(part_den);
+    if (error) *error = 100.0 * sqrt(num) / (den < 1e-24 ? 1.0 : sqrt(den));
+    return SVDIMG_OK;
+}
+
+int svdimg_reconstruct_u8(svdimg_ctx *ctx, const unsigned char *img, int m, int n, size_t stride,
+                          int k, unsigned char *out, size_t out_stride, double *error) {
+    if (bad_args(ctx, img, m, n, stride, k) || !out || out_stride < (size_t)n)
+        return SVDIMG_EINVAL;
+    svdimg_job j;
+    int rc = start_job(ctx, m, n, k, NULL, &j);
+    if (rc != SVDIMG_OK) return rc;
+    double energy = load_u8(j.A_res, img, m, n, stride);
+    rc = run_job(ctx, &j, m, n, k, energy, NULL, 0, NULL, NULL, 0);
+    if (rc != SVDIMG_OK) return rc;
+
+    double part_num[SVDIMG_CHUNKS], part_den[SVDIMG_CHUNKS];
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < SVDIMG_CHUNKS; q++) {
+        int i0, i1;
+        threads_row_range(m, q, SVDIMG_CHUNKS, &i0, &i1);
+        double num = 0.0, den = 0.0;
+        for (int i = i0; i < i1; i++) {
+            const unsigned char *a = img + (size_t)i * stride;
+            const float *ak = j.A_app + (size_t)i * n;
+            unsigned char *o = out + (size_t)i * out_stride;
+            for (int c = 0; c < n; c++) {
+                double d = (double)a[c] - ak[c];
+                num += d * d;
+                den += (double)a[c] * a[c];
+                float v = ak[c] + 0.5f;
+                o[c] = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (unsigned char)v;
+            }
+        }
+        part_num[q] = num;
+        part_den[q] = den;
+    }
+    double num = sum_parts(part_num), den = sum_parts(part_den);
+    if (error) *error = 100.0 * sqrt(num) / (den < 1e-24 ? 1.0 : sqrt(den));
+    return SVDIMG_OK;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/svd_factors.h"
+#include "../c_libs/synth.h"
+
+/*Synthetic test matrices*/
+
+void synth_default_params(synth_params *p) {
+    p->profile = SYNTH_EXP;
+    p->rank = 64;
+    p->top = 1000.0;
+    p->param = 0.0;
+    p->noise = 0.0;
+    p->mean = 0.0;
+    p->seed = 1;
+}
+
+int synth_profile_from_name(const char *name) {
+    if (strcmp(name, "exp") == 0) return SYNTH_EXP;
+    if (strcmp(name, "power") == 0) return SYNTH_POWER;
+    if (strcmp(name, "cluster") == 0) return SYNTH_CLUSTER;
+    if (strcmp(name, "rankdef") == 0) return SYNTH_RANKDEF;
+    return -1;
+}
+
+void synth_singular_values(const synth_params *p, float *S) {
+    int r = p->rank;
+    for (int i = 0; i < r; i++) {
+        double s;
+        switch (p->profile) {
+        case SYNTH_POWER:
+            s = pow(i + 1.0, -(p->param > 0.0 ? p->param : 1.0));
+            break;
+        case SYNTH_CLUSTER: {
+            int size = p->param >= 1.0 ? (int)p->param : 4;
+            s = pow(0.5, (double)(i / size));
+            break;
+        }
+        case SYNTH_RANKDEF:
+            s = 1.0 - 0.5 * i / r;
+            break;
+        default:
+            s = pow(p->param > 0.0 ? p->param : 0.9, (double)i);
+            break;
+        }
+        S[i] = (float)(p->top * s);
+    }
+}
+
+/* Counter based random numbers: every column of U and V and every row of
+   noise has its own stream, so nothing depends on the order of filling */
+static unsigned long long splitmix(unsigned long long *x) {
+    unsigned long long z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Box-Muller, one normal value per call */
+static double gauss(unsigned long long *x) {
+    double u1 = ((splitmix(x) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    double u2 = (splitmix(x) >> 11) * (1.0 / 9007199254740992.0);
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+static void random_column(float *X, int rows, int ld, int col, unsigned long long seed) {
+    unsigned long long s = seed * 0x2545F4914F6CDD1DULL + (unsigned long long)col;
+    for (int i = 0; i < rows; i++)
+        X[(size_t)i * ld + col] = (float)gauss(&s);
+}
+
+static void swap_columns(svd_factors *f, int a, int b) {
+    float t = f->S[a]; f->S[a] = f->S[b]; f->S[b] = t;
+    for (int i = 0; i < f->m; i++) {
+        float *u = f->U + (size_t)i * f->kmax;
+        t = u[a]; u[a] = u[b]; u[b] = t;
+    }
+    for (int i = 0; i < f->n; i++) {
+        float *v = f->V + (size_t)i * f->kmax;
+        t = v[a]; v[a] = v[b]; v[b] = t;
+    }
+}
+
+int synth_generate(const synth_params *p, int m, int n, float *A, svd_factors *truth) {
+    int off = p->mean > 0.0 ? 1 : 0;
+    int side = m < n ? m : n;
+    synth_params q = *p;
+    if (q.rank > side - off) q.rank = side - off;
+    if (q.rank < 1) q.rank = 1;
+    int kk = q.rank + off;
+
+    svd_factors f;
+    if (svd_factors_init(&f, m, n, kk) != 0) return -1;
+    f.k = kk;
+
+    // U and V: Gaussian columns made orthonormal. With a mean the first
+    // pair is constant, Gram-Schmidt keeps it and makes the rest zero mean
+    for (int c = 0; c < kk; c++) {
+        if (c < off) {
+            for (int i = 0; i < m; i++) f.U[(size_t)i * kk] = 1.0f;
+            for (int i = 0; i < n; i++) f.V[(size_t)i * kk] = 1.0f;
+            continue;
+        }
+        random_column(f.U, m, kk, c, 2 * p->seed);
+        random_column(f.V, n, kk, c, 2 * p->seed + 1);
+    }
+    qr_modified_gram_schmidt(f.U, m, kk, kk);
+    qr_modified_gram_schmidt(f.V, n, kk, kk);
+    synth_singular_values(&q, f.S + off);
+
+    memset(A, 0, (size_t)m * n * sizeof(float));
+    if (rank_update(A, NULL, m, n, f.U, f.S, f.V, kk, NULL) != 0) {
+        svd_factors_free(&f);
+        return -1;
+    }
+
+    if (off) {
+        // Fit the varying part into ±127 around the mean
+        float maxabs = 0.0f;
+        for (size_t i = 0; i < (size_t)m * n; i++)
+            if (fabsf(A[i]) > maxabs) maxabs = fabsf(A[i]);
+        float scale = maxabs > 0.0f ? 127.0f / maxabs : 1.0f;
+        for (int c = off; c < kk; c++) f.S[c] *= scale;
+        f.S[0] = (float)(p->mean * sqrt((double)m * n));
+        float mean = (float)p->mean;
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < m; i++)
+            for (int j = 0; j < n; j++)
+                A[(size_t)i * n + j] = A[(size_t)i * n + j] * scale + mean;
+        // A small mean can drop below the largest varying value
+        for (int c = 1; c < kk && f.S[c] > f.S[c - 1]; c++)
+            swap_columns(&f, c, c - 1);
+    }
+
+    if (p->noise > 0.0) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < m; i++) {
+            unsigned long long s = (p->seed + 0x51ED27ULL) * 0xD1B54A32D192ED03ULL + (unsigned long long)i;
+            for (int j = 0; j < n; j++)
+                A[(size_t)i * n + j] += (float)(p->noise * gauss(&s));
+        }
+    }
+
+    if (truth) *truth = f;
+    else svd_factors_free(&f);
+    return 0;
+}
+
+double synth_best_error(const svd_factors *truth, int k) {
+    double total = 0.0, tail = 0.0;
+    for (int i = 0; i < truth->k; i++) {
+        double s2 = (double)truth->S[i] * truth->S[i];
+        total += s2;
+        if (i >= k) tail += s2;
+    }
+    return total > 0.0 ? 100.0 * sqrt(tail / total) : 0.0;
+}
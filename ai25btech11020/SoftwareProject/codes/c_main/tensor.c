@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/pgm_io.h"
+#include "../c_libs/tucker.h"
+
+/* Tensor mode: a stack of same-size frames compressed together.
+
+   ./tensor encode out.tuck r1 r2 r3 [--hooi N] frame000.pgm frame001.pgm ...
+        r1, r2 = ranks along rows and columns, r3 = rank along time
+   ./tensor decode in.tuck out_prefix      writes out_prefix_000.pgm, ... */
+
+static int encode(int argc, char **argv) {
+    if (argc < 7) {
+        fprintf(stderr, "Usage: %s encode out.tuck r1 r2 r3 [--hooi N] frames...\n", argv[0]);
+        return 1;
+    }
+    const char *out_path = argv[2];
+    int r1 = atoi(argv[3]), r2 = atoi(argv[4]), r3 = atoi(argv[5]), hooi = 0;
+    const char *files[4096];
+    int t = 0;
+    for (int a = 6; a < argc; a++) {
+        if (strcmp(argv[a], "--hooi") == 0 && a + 1 < argc) hooi = atoi(argv[++a]);
+        else if (t < 4096) files[t++] = argv[a];
+    }
+    if (t == 0) {
+        fprintf(stderr, "Error: no frames given\n");
+        return 1;
+    }
+
+    // Read all frames into one m×n×t block
+    int m = 0, n = 0;
+    FILE *hf = pgm_stream_open(files[0], &m, &n);
+    if (!hf) return 1;
+    fclose(hf);
+    size_t mn = (size_t)m * n;
+    float *X = (float*)malloc(mn * t * sizeof(float));
+    if (!X) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        return 1;
+    }
+    for (int f = 0; f < t; f++) {
+        int mf, nf;
+        FILE *fp = pgm_stream_open(files[f], &mf, &nf);
+        int ok = fp && mf == m && nf == n && pgm_stream_read_rows(fp, X + f * mn, m, n) == m;
+        if (fp) fclose(fp);
+        if (!ok) {
+            fprintf(stderr, "Error: %s is missing or not %dx%d\n", files[f], m, n);
+            free(X);
+            return 1;
+        }
+    }
+
+    tucker tk;
+    if (tucker_decompose(X, m, n, t, r1, r2, r3, hooi, &tk) != 0) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        free(X);
+        return 1;
+    }
+
+    // Error of the whole stack and size compared with the raw frames
+    float *frame = (float*)malloc(mn * sizeof(float));
+    double num = 0.0, den = 0.0;
+    int ok = frame != NULL;
+    for (int f = 0; ok && f < t; f++) {
+        ok = tucker_decode_frame(&tk, f, frame) == 0;
+        if (!ok) break;
+        const float *Xf = X + f * mn;
+        for (size_t i = 0; i < mn; i++) {
+            double d = (double)Xf[i] - frame[i];
+            num += d * d;
+            den += (double)Xf[i] * Xf[i];
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        free(frame);
+        free(X);
+        tucker_free(&tk);
+        return 1;
+    }
+    size_t floats = (size_t)tk.r1 * tk.r2 * tk.r3 + (size_t)m * tk.r1 + (size_t)n * tk.r2 + (size_t)t * tk.r3;
+    printf("%d frames of %dx%d, ranks %d %d %d\n", t, m, n, tk.r1, tk.r2, tk.r3);
+    printf("Percentage error: %.4f%%\n", den > 0.0 ? 100.0 * sqrt(num / den) : 0.0);
+    printf("Stored floats: %zu (frames have %zu, %.1fx smaller)\n", floats, mn * t, (double)(mn * t) / floats);
+
+    int rc = tucker_save(out_path, &tk) == 0 ? 0 : 1;
+    if (rc == 0) printf("Saved %s\n", out_path);
+    free(frame);
+    free(X);
+    tucker_free(&tk);
+    return rc;
+}
+
+static int decode(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s decode in.tuck out_prefix\n", argv[0]);
+        return 1;
+    }
+    tucker tk;
+    if (tucker_load(argv[2], &tk) != 0) return 1;
+    float *frame = (float*)malloc((size_t)tk.m * tk.n * sizeof(float));
+    if (!frame) {
+        fprintf(stderr, "Error: could not allocate memory.\n");
+        tucker_free(&tk);
+        return 1;
+    }
+    char name[1024];
+    for (int f = 0; f < tk.t; f++) {
+        if (tucker_decode_frame(&tk, f, frame) != 0) {
+            fprintf(stderr, "Error: could not allocate memory.\n");
+            free(frame);
+            tucker_free(&tk);
+            return 1;
+        }
+        snprintf(name, sizeof(name), "%s_%03d.pgm", argv[3], f);
+        write_pgm(name, frame, tk.m, tk.n);
+    }
+    printf("Saved %d frames as %s_###.pgm\n", tk.t, argv[3]);
+    free(frame);
+    tucker_free(&tk);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "encode") == 0) return encode(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "decode") == 0) return decode(argc, argv);
+    fprintf(stderr, "Usage: %s encode | decode ...\n", argv[0]);
+    return 1;
+}
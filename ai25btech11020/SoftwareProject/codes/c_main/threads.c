@@ -0,0 +1,116 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../c_libs/threads.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Threads the kernels should use. Inside somebody else's parallel
+   region (for example one tile per thread) the kernels stay serial */
+int threads_count(void) {
+#ifdef _OPENMP
+    if (omp_in_parallel()) return 1;
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void threads_set(int n) {
+#ifdef _OPENMP
+    if (n > 0) omp_set_num_threads(n);
+#else
+    (void)n;
+#endif
+}
+
+int threads_id(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+int threads_in_team(void) {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+/* Pins thread t of the team to core t (mod number of cores), so the
+   row band a thread owns stays next to the memory it touched first.
+   Returns how many threads were pinned */
+int threads_pin(void) {
+    int pinned = 0;
+#if defined(__linux__) && defined(_OPENMP)
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    #pragma omp parallel reduction(+:pinned)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(threads_id() % ncpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == 0) pinned++;
+    }
+#endif
+    return pinned;
+}
+
+/* Rows [i0, i1) of an m row matrix belong to thread t out of nt.
+   Every kernel and the first touch use this same split */
+void threads_row_range(int m, int t, int nt, int *i0, int *i1) {
+    *i0 = (int)((long long)m * t / nt);
+    *i1 = (int)((long long)m * (t + 1) / nt);
+}
+
+/* Reused buffer for the partial results of one parallel region, only
+   grows. Every calling thread has its own, so kernels started from two
+   pthreads at once (daemon workers, one svdimg context each) do not share
+   it. Call it outside parallel regions */
+static _Thread_local float *scratch_buf = NULL;
+static _Thread_local size_t scratch_cap = 0;
+
+float* threads_scratch(size_t floats) {
+    if (floats > scratch_cap) {
+        float *p = (float*)realloc(scratch_buf, floats * sizeof(float));
+        if (!p) return NULL;
+        scratch_buf = p;
+        scratch_cap = floats;
+    }
+    return scratch_buf;
+}
+
+/* Frees the calling thread's scratch, for threads that end before the process */
+void threads_scratch_release(void) {
+    free(scratch_buf);
+    scratch_buf = NULL;
+    scratch_cap = 0;
+}
+
+void first_touch_copy(float *dst, const float *src, int m, int n) {
+    #pragma omp parallel num_threads(threads_count())
+    {
+        int i0, i1;
+        threads_row_range(m, threads_id(), threads_in_team(), &i0, &i1);
+        memcpy(dst + (size_t)i0 * n, src + (size_t)i0 * n, (size_t)(i1 - i0) * n * sizeof(float));
+    }
+}
+
+void first_touch_zero(float *dst, int m, int n) {
+    #pragma omp parallel num_threads(threads_count())
+    {
+        int i0, i1;
+        threads_row_range(m, threads_id(), threads_in_team(), &i0, &i1);
+        memset(dst + (size_t)i0 * n, 0, (size_t)(i1 - i0) * n * sizeof(float));
+    }
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/tiled.h"
+
+/*Tiled SVD with rank allocation*/
+
+void tiled_default_params(tiled_params *p) {
+    p->tile = 64;
+    p->quadtree = 0;
+    p->min_tile = 16;
+    p->max_rank = 16;
+    p->split_error = 0.05;
+}
+
+/* Runs svd_block_step on the h×w block at (r0, c0) of A (minus shift)
+   until max_rank vectors are found or the squared error left is below
+   tol² of the block's energy, keeping U, S, V in f. Returns 0 on success. */
+int tiled_factor_block(const float *A, int lda, int r0, int c0, int h, int w, float shift,
+                       int max_rank, double tol, svd_factors *f, double *energy_out) {
+    int kcap = max_rank;
+    if (kcap > h) kcap = h;
+    if (kcap > w) kcap = w;
+    if (kcap < 1) kcap = 1;
+    int bmax = kcap < SVD_MAX_FIXED_B ? kcap : SVD_MAX_FIXED_B;
+
+    float *res = (float*)malloc((size_t)h * w * sizeof(float));
+    float *app = (float*)calloc((size_t)h * w, sizeof(float));
+    float *V = (float*)malloc((size_t)w * bmax * sizeof(float));
+    float *Y = (float*)malloc((size_t)h * bmax * sizeof(float));
+    float *Z = (float*)malloc((size_t)w * bmax * sizeof(float));
+    float *PrevV = (float*)calloc((size_t)w * kcap, sizeof(float));
+    int bad = !res || !app || !V || !Y || !Z || !PrevV || svd_factors_init(f, h, w, kcap) != 0;
+
+    if (!bad) {
+        double energy = 0.0;
+        for (int i = 0; i < h; ++i)
+            for (int j = 0; j < w; ++j) {
+                float a = A[(size_t)(r0 + i) * lda + c0 + j] - shift;
+                res[(size_t)i * w + j] = a;
+                energy += (double)a * a;
+            }
+        if (energy_out) *energy_out = energy;
+
+        int prev_cols = 0;
+        double left = energy;
+        while (prev_cols < max_rank && prev_cols < kcap && left > tol * tol * energy) {
+            int b = kcap - prev_cols < bmax ? kcap - prev_cols : bmax;
+            if (svd_block_step(res, h, w, b, app, V, Y, Z, 100, 1e-5f, PrevV, prev_cols, kcap, NULL) != 0) {
+                bad = 1;
+                break;
+            }
+            svd_factors_add_block(f, Y, V, b);
+            for (int j = 0; j < b; ++j) {
+                for (int i = 0; i < w; ++i)
+                    PrevV[(size_t)i * kcap + prev_cols + j] = V[(size_t)i * b + j];
+                left -= (double)f->S[prev_cols + j] * f->S[prev_cols + j];
+            }
+            prev_cols += b;
+        }
+    }
+    free(res); free(app); free(V); free(Y); free(Z); free(PrevV);
+    return bad ? -1 : 0;
+}
+
+static int factor_tile(const float *A, int n, tiled_tile *t, int max_rank) {
+    double sum = 0.0;
+    for (int i = 0; i < t->h; ++i)
+        for (int j = 0; j < t->w; ++j)
+            sum += A[(size_t)(t->r0 + i) * n + t->c0 + j];
+    t->mean = (float)(sum / ((double)t->h * t->w));
+    return tiled_factor_block(A, n, t->r0, t->c0, t->h, t->w, t->mean, max_rank, 1e-5, &t->f, &t->energy);
+}
+
+/* Squared Frobenius norm of the tile itself (mean included) */
+static double tile_norm2(const tiled_tile *t) {
+    return t->energy + (double)t->h * t->w * t->mean * t->mean;
+}
+
+/* Squared error of a tile when all of its vectors are used */
+static double tile_floor(const tiled_tile *t) {
+    double left = t->energy;
+    for (int j = 0; j < t->f.k; ++j)
+        left -= (double)t->f.S[j] * t->f.S[j];
+    return left > 0.0 ? left : 0.0;
+}
+
+static int add_tile(tiled_image *ti, int *cap, int r0, int c0, int h, int w) {
+    if (ti->count == *cap) {
+        int nc = *cap ? 2 * *cap : 64;
+        tiled_tile *p = (tiled_tile*)realloc(ti->tiles, (size_t)nc * sizeof(tiled_tile));
+        if (!p) return -1;
+        ti->tiles = p;
+        *cap = nc;
+    }
+    tiled_tile *t = &ti->tiles[ti->count++];
+    memset(t, 0, sizeof(*t));
+    t->r0 = r0; t->c0 = c0; t->h = h; t->w = w;
+    return 0;
+}
+
+/* Cuts the image into tiles and factors them, one tile per thread.
+   With quadtree, tiles that are still above split_error after max_rank
+   vectors are replaced by their four quarters, which are factored in the
+   next round. */
+tiled_image* tiled_factor(const float *A, int m, int n, const tiled_params *p) {
+    tiled_image *ti = (tiled_image*)calloc(1, sizeof(tiled_image));
+    if (!ti) return NULL;
+    ti->m = m;
+    ti->n = n;
+    int cap = 0, size = p->tile > 0 ? p->tile : 64;
+
+    for (int r0 = 0; r0 < m; r0 += size)
+        for (int c0 = 0; c0 < n; c0 += size)
+            if (add_tile(ti, &cap, r0, c0, m - r0 < size ? m - r0 : size, n - c0 < size ? n - c0 : size) != 0) {
+                tiled_free(ti);
+                return NULL;
+            }
+
+    int first = 0;
+    while (first < ti->count) {
+        int last = ti->count, failed = 0;
+
+        #pragma omp parallel for schedule(dynamic) reduction(+:failed)
+        for (int i = first; i < last; ++i)
+            failed += factor_tile(A, n, &ti->tiles[i], p->max_rank) != 0;
+        if (failed) {
+            tiled_free(ti);
+            return NULL;
+        }
+        if (!p->quadtree)
+            break;
+
+        // Split the tiles that are still detailed, children go to the end
+        for (int i = first; i < last; ++i) {
+            tiled_tile t = ti->tiles[i];
+            int h2 = t.h / 2, w2 = t.w / 2;
+            if (h2 < p->min_tile || w2 < p->min_tile) continue;
+            if (tile_floor(&t) <= p->split_error * p->split_error * tile_norm2(&t)) continue;
+
+            svd_factors_free(&ti->tiles[i].f);
+            ti->tiles[i].h = 0;   // marks the parent as replaced
+            if (add_tile(ti, &cap, t.r0, t.c0, h2, w2) != 0 ||
+                add_tile(ti, &cap, t.r0, t.c0 + w2, h2, t.w - w2) != 0 ||
+                add_tile(ti, &cap, t.r0 + h2, t.c0, t.h - h2, w2) != 0 ||
+                add_tile(ti, &cap, t.r0 + h2, t.c0 + w2, t.h - h2, t.w - w2) != 0) {
+                tiled_free(ti);
+                return NULL;
+            }
+        }
+        first = last;
+    }
+
+    // Drop the replaced parents
+    int keep = 0;
+    for (int i = 0; i < ti->count; ++i)
+        if (ti->tiles[i].h > 0)
+            ti->tiles[keep++] = ti->tiles[i];
+    ti->count = keep;
+    return ti;
+}
+
+/*Rank allocation*/
+
+typedef struct {
+    double gain;    // squared singular value, the error it removes
+    double ratio;   // gain per stored float
+    int tile;
+} tiled_cand;
+
+static int by_ratio(const void *a, const void *b) {
+    double x = ((const tiled_cand*)a)->ratio, y = ((const tiled_cand*)b)->ratio;
+    return (x < y) - (x > y);
+}
+
+/* Greedy rate-distortion allocation: the tile means are always kept (one
+   float each), then every vector of every tile removes sigma² of squared
+   error and costs h + w + 1 floats. Vectors are taken best ratio first
+   until the float budget is used up or the error drops to max_error (a
+   fraction of ||A||, 0 for none). A budget of 0 means no limit.
+   Sets the rank of every tile and returns the floats used. */
+size_t tiled_allocate(tiled_image *ti, size_t float_budget, double max_error) {
+    size_t total = 0;
+    double energy = 0.0, left = 0.0;
+    for (int i = 0; i < ti->count; ++i) {
+        total += (size_t)ti->tiles[i].f.k;
+        energy += tile_norm2(&ti->tiles[i]);
+        left += ti->tiles[i].energy;
+        ti->tiles[i].rank = 0;
+    }
+
+    tiled_cand *c = (tiled_cand*)malloc((total ? total : 1) * sizeof(tiled_cand));
+    if (!c) return 0;
+    size_t nc = 0;
+    for (int i = 0; i < ti->count; ++i) {
+        const tiled_tile *t = &ti->tiles[i];
+        for (int j = 0; j < t->f.k; ++j) {
+            double s = t->f.S[j];
+            c[nc].gain = s * s;
+            c[nc].ratio = s * s / (double)(t->h + t->w + 1);
+            c[nc].tile = i;
+            nc++;
+        }
+    }
+    qsort(c, nc, sizeof(tiled_cand), by_ratio);
+
+    double target = max_error > 0.0 ? max_error * max_error * energy : -1.0;
+    size_t used = (size_t)ti->count;
+    for (size_t q = 0; q < nc && left > target; ++q) {
+        tiled_tile *t = &ti->tiles[c[q].tile];
+        size_t cost = (size_t)(t->h + t->w + 1);
+        if (c[q].gain <= 0.0) break;
+        if (float_budget > 0 && used + cost > float_budget) continue;
+        t->rank++;
+        used += cost;
+        left -= c[q].gain;
+    }
+    free(c);
+    return used;
+}
+
+void tiled_reconstruct(const tiled_image *ti, float *A_out) {
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < ti->count; ++i) {
+        const tiled_tile *t = &ti->tiles[i];
+        float *out = A_out + (size_t)t->r0 * ti->n + t->c0;
+        if (t->rank > 0) {
+            svd_reconstruct_window(&t->f, t->rank, 0, 0, t->h, t->w, out, ti->n);
+            for (int r = 0; r < t->h; ++r)
+                for (int c = 0; c < t->w; ++c)
+                    out[(size_t)r * ti->n + c] += t->mean;
+        } else {
+            for (int r = 0; r < t->h; ++r)
+                for (int c = 0; c < t->w; ++c)
+                    out[(size_t)r * ti->n + c] = t->mean;
+        }
+    }
+}
+
+void tiled_free(tiled_image *ti) {
+    if (!ti) return;
+    for (int i = 0; i < ti->count; ++i)
+        svd_factors_free(&ti->tiles[i].f);
+    free(ti->tiles);
+    free(ti);
+}
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/svd_utils.h"
+#include "../c_libs/tucker.h"
+
+/*Tucker decomposition of a frame stack*/
+
+#define TUCKER_MAX_ITER 100
+#define TUCKER_TOL 1e-5f
+
+/* Everything an operator W -> G W needs. G is never formed, it is
+   applied through the matmul kernels frame by frame */
+typedef struct {
+    const float *X;     // frames
+    int m, n, t;
+    const float *M;     // explicit d×p matrix (HOOI unfoldings)
+    int p;
+    float *Tm, *Tn;     // scratch, m×r and n×r (or p×r)
+    float *acc;         // scratch, d×r
+} tucker_op;
+
+/* Mode 1: sum over frames of X_f X_fᵀ W (m×r) */
+static void op_rows(tucker_op *o, const float *W, float *out, int r) {
+    size_t mr = (size_t)o->m * r;
+    memset(out, 0, mr * sizeof(float));
+    for (int f = 0; f < o->t; ++f) {
+        const float *Xf = o->X + (size_t)f * o->m * o->n;
+        matmul_AT_times_Y(Xf, W, o->Tn, o->m, o->n, r);
+        matmul_A_times_V(Xf, o->Tn, o->acc, o->m, o->n, r);
+        for (size_t i = 0; i < mr; ++i) out[i] += o->acc[i];
+    }
+}
+
+/* Mode 2: sum over frames of X_fᵀ X_f W (n×r) */
+static void op_cols(tucker_op *o, const float *W, float *out, int r) {
+    size_t nr = (size_t)o->n * r;
+    memset(out, 0, nr * sizeof(float));
+    for (int f = 0; f < o->t; ++f) {
+        const float *Xf = o->X + (size_t)f * o->m * o->n;
+        matmul_A_times_V(Xf, W, o->Tm, o->m, o->n, r);
+        matmul_AT_times_Y(Xf, o->Tm, o->acc, o->m, o->n, r);
+        for (size_t i = 0; i < nr; ++i) out[i] += o->acc[i];
+    }
+}
+
+/* HOOI: M Mᵀ W for the explicit d×p matrix M (d×r) */
+static void op_matrix(tucker_op *o, const float *W, float *out, int r) {
+    int d = o->m;
+    matmul_AT_times_Y(o->M, W, o->Tn, d, o->p, r);
+    matmul_A_times_V(o->M, o->Tn, out, d, o->p, r);
+}
+
+/* Top r eigenvectors of the d×d operator (block power iteration, QR every
+   step and the same Ritz value test as svd_block_step). U is d×r. */
+static int top_vectors(void (*op)(tucker_op*, const float*, float*, int), tucker_op *o,
+                       int d, int r, float *U) {
+    float *Z = (float*)malloc((size_t)d * r * sizeof(float));
+    float *R = (float*)malloc(((size_t)r * r + r) * sizeof(float));
+    if (!Z || !R) {
+        free(Z); free(R);
+        return -1;
+    }
+    float *ritz_prev = R + (size_t)r * r;
+
+    // Fixed pseudo random start, so that no direction is missing from it
+    unsigned int s = 2463534242u;
+    for (size_t i = 0; i < (size_t)d * r; ++i) {
+        s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+        U[i] = (float)(s >> 8) / 16777216.0f - 0.5f;
+    }
+    qr_modified_gram_schmidt(U, d, r, r);
+
+    float *V = U, *W = Z;
+    for (int iter = 0; iter < TUCKER_MAX_ITER; ++iter) {
+        op(o, V, W, r);
+        qr_modified_gram_schmidt_r(W, d, r, r, R);
+        float *tmp = V; V = W; W = tmp;
+        if (ritz_converged(R, r + 1, r, ritz_prev, iter == 0, TUCKER_TOL))
+            break;
+    }
+    if (V != U)
+        memcpy(U, V, (size_t)d * r * sizeof(float));
+    free(Z); free(R);
+    return 0;
+}
+
+/* Top r eigenvectors of the count×count Gram matrix of the given rows
+   (each len floats, stride apart). Used for the short time direction. */
+static int gram_top_vectors(const float *rows, size_t stride, int count, size_t len,
+                            int r, float *U) {
+    float *G = (float*)calloc((size_t)count * count, sizeof(float));
+    float *E = (float*)malloc((size_t)count * count * sizeof(float));
+    float *Ev = (float*)malloc((size_t)count * count * sizeof(float));
+    float *S = (float*)malloc((size_t)count * sizeof(float));
+    if (!G || !E || !Ev || !S) {
+        free(G); free(E); free(Ev); free(S);
+        return -1;
+    }
+    for (int a = 0; a < count; ++a)
+        for (int b = a; b < count; ++b) {
+            const float *x = rows + a * stride, *y = rows + b * stride;
+            double sum = 0.0;
+            for (size_t i = 0; i < len; ++i)
+                sum += (double)x[i] * y[i];
+            G[(size_t)a * count + b] = G[(size_t)b * count + a] = (float)sum;
+        }
+    small_svd_jacobi(G, count, count, E, S, Ev);
+    for (int a = 0; a < count; ++a)
+        memcpy(U + (size_t)a * r, E + (size_t)a * count, (size_t)r * sizeof(float));
+    free(G); free(E); free(Ev); free(S);
+    return 0;
+}
+
+/* P_f = U1ᵀ X_f U2 (r1×r2) for every frame */
+static void project_frames(const float *X, const tucker *tk, float *Tm, float *P) {
+    size_t mn = (size_t)tk->m * tk->n, rr = (size_t)tk->r1 * tk->r2;
+    for (int f = 0; f < tk->t; ++f) {
+        matmul_A_times_V(X + f * mn, tk->U2, Tm, tk->m, tk->n, tk->r2);
+        matmul_AT_times_Y(tk->U1, Tm, P + f * rr, tk->m, tk->r1, tk->r2);
+    }
+}
+
+/* M (rows×(w*r3)) = sum over frames of U3(f, c) T_f in column block c,
+   T_f = frame(X_f) is rows×w */
+static void fold_time(const float *Tf, const float *u3row, int rows, int w, int r3, float *M) {
+    size_t ld = (size_t)w * r3;
+    for (int i = 0; i < rows; ++i)
+        for (int c = 0; c < r3; ++c) {
+            float s = u3row[c];
+            float *dst = M + (size_t)i * ld + (size_t)c * w;
+            const float *src = Tf + (size_t)i * w;
+            for (int j = 0; j < w; ++j)
+                dst[j] += s * src[j];
+        }
+}
+
+static int min_int(int a, int b) { return a < b ? a : b; }
+
+/* Step 1: HOSVD, every factor from its own unfolding.
+   Step 2: HOOI, every factor again from the tensor already reduced in the
+           other two directions, which lowers the error a little more.
+   Step 3: core G = X ×1 U1ᵀ ×2 U2ᵀ ×3 U3ᵀ */
+int tucker_decompose(const float *X, int m, int n, int t, int r1, int r2, int r3,
+                     int hooi_iters, tucker *tk) {
+    memset(tk, 0, sizeof(*tk));
+    if (m <= 0 || n <= 0 || t <= 0 || r1 <= 0 || r2 <= 0 || r3 <= 0) return -1;
+    r1 = min_int(r1, m); r2 = min_int(r2, n); r3 = min_int(r3, t);
+    r1 = min_int(r1, r2 * r3); r2 = min_int(r2, r1 * r3); r3 = min_int(r3, r1 * r2);
+    tk->m = m; tk->n = n; tk->t = t; tk->r1 = r1; tk->r2 = r2; tk->r3 = r3;
+
+    size_t rr = (size_t)r1 * r2;
+    int wide = r2 * r3 > r1 * r3 ? r2 * r3 : r1 * r3;
+    int rmax = r1 > r2 ? r1 : r2;
+    int big = m > n ? m : n;
+    tk->G = (float*)calloc((size_t)r3 * rr, sizeof(float));
+    tk->U1 = (float*)malloc((size_t)m * r1 * sizeof(float));
+    tk->U2 = (float*)malloc((size_t)n * r2 * sizeof(float));
+    tk->U3 = (float*)malloc((size_t)t * r3 * sizeof(float));
+    float *P = (float*)malloc((size_t)t * rr * sizeof(float));
+    float *Tm = (float*)malloc((size_t)big * (wide > rmax ? wide : rmax) * sizeof(float));
+    float *Tn = (float*)malloc((size_t)big * (wide > rmax ? wide : rmax) * sizeof(float));
+    float *acc = (float*)malloc((size_t)big * rmax * sizeof(float));
+    float *M = (float*)malloc((size_t)big * wide * sizeof(float));
+    int bad = !tk->G || !tk->U1 || !tk->U2 || !tk->U3 || !P || !Tm || !Tn || !acc || !M;
+
+    tucker_op o = { X, m, n, t, NULL, 0, Tm, Tn, acc };
+    size_t mn = (size_t)m * n;
+
+    // Step 1: HOSVD
+    if (!bad) {
+        bad = top_vectors(op_rows, &o, m, r1, tk->U1) != 0 ||
+              top_vectors(op_cols, &o, n, r2, tk->U2) != 0 ||
+              gram_top_vectors(X, mn, t, mn, r3, tk->U3) != 0;
+    }
+
+    // Step 2: HOOI
+    for (int it = 0; !bad && it < hooi_iters; ++it) {
+        // U1 from X ×2 U2ᵀ ×3 U3ᵀ, an m×(r2 r3) matrix
+        memset(M, 0, (size_t)m * r2 * r3 * sizeof(float));
+        for (int f = 0; f < t; ++f) {
+            matmul_A_times_V(X + f * mn, tk->U2, Tm, m, n, r2);
+            fold_time(Tm, tk->U3 + (size_t)f * r3, m, r2, r3, M);
+        }
+        tucker_op om = { X, m, n, t, M, r2 * r3, Tm, Tn, acc };
+        bad = top_vectors(op_matrix, &om, m, r1, tk->U1) != 0;
+
+        // U2 from X ×1 U1ᵀ ×3 U3ᵀ, an n×(r1 r3) matrix
+        memset(M, 0, (size_t)n * r1 * r3 * sizeof(float));
+        for (int f = 0; !bad && f < t; ++f) {
+            matmul_AT_times_Y(X + f * mn, tk->U1, Tn, m, n, r1);
+            fold_time(Tn, tk->U3 + (size_t)f * r3, n, r1, r3, M);
+        }
+        tucker_op on = { X, n, m, t, M, r1 * r3, Tm, Tn, acc };
+        bad = bad || top_vectors(op_matrix, &on, n, r2, tk->U2) != 0;
+
+        // U3 from X ×1 U1ᵀ ×2 U2ᵀ, a t×(r1 r2) matrix
+        if (!bad) {
+            project_frames(X, tk, Tm, P);
+            bad = gram_top_vectors(P, rr, t, rr, r3, tk->U3) != 0;
+        }
+    }
+
+    // Step 3: core
+    if (!bad) {
+        project_frames(X, tk, Tm, P);
+        for (int c = 0; c < r3; ++c) {
+            float *Gc = tk->G + (size_t)c * rr;
+            for (int f = 0; f < t; ++f) {
+                float s = tk->U3[(size_t)f * r3 + c];
+                const float *Pf = P + (size_t)f * rr;
+                for (size_t i = 0; i < rr; ++i)
+                    Gc[i] += s * Pf[i];
+            }
+        }
+    }
+
+    free(P); free(Tm); free(Tn); free(acc); free(M);
+    if (bad) {
+        tucker_free(tk);
+        return -1;
+    }
+    return 0;
+}
+
+/* frame f = U1 H_f U2ᵀ with H_f = sum over c of U3(f, c) G_c.
+   Costs r3·r1·r2 + m·r1·r2 + m·n·r2, no matter how many frames there are.
+   Returns -1 (frame untouched) if the scratch could not be allocated */
+int tucker_decode_frame(const tucker *tk, int f, float *frame) {
+    int m = tk->m, n = tk->n, r1 = tk->r1, r2 = tk->r2, r3 = tk->r3;
+    size_t rr = (size_t)r1 * r2;
+    float *H = (float*)calloc(rr, sizeof(float));
+    float *T = (float*)malloc(((size_t)m * r2 + (size_t)r2 * n) * sizeof(float)); // U1 H_f, then rank_update scratch
+    if (!H || !T) {
+        free(H); free(T);
+        return -1;
+    }
+    for (int c = 0; c < r3; ++c) {
+        float s = tk->U3[(size_t)f * r3 + c];
+        const float *Gc = tk->G + (size_t)c * rr;
+        for (size_t i = 0; i < rr; ++i)
+            H[i] += s * Gc[i];
+    }
+    matmul_A_times_V(tk->U1, H, T, m, r1, r2);
+    memset(frame, 0, (size_t)m * n * sizeof(float));
+    rank_update(frame, NULL, m, n, T, NULL, tk->U2, r2, T + (size_t)m * r2);
+    free(H); free(T);
+    return 0;
+}
+
+/*Tucker file*/
+
+int tucker_save(const char *path, const tucker *tk) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+    int head[6] = { tk->m, tk->n, tk->t, tk->r1, tk->r2, tk->r3 };
+    size_t ng = (size_t)tk->r3 * tk->r1 * tk->r2;
+    size_t n1 = (size_t)tk->m * tk->r1, n2 = (size_t)tk->n * tk->r2, n3 = (size_t)tk->t * tk->r3;
+    int bad = fwrite("TUCK", 1, 4, fp) != 4 || fwrite(head, sizeof(int), 6, fp) != 6 ||
+              fwrite(tk->G, sizeof(float), ng, fp) != ng ||
+              fwrite(tk->U1, sizeof(float), n1, fp) != n1 ||
+              fwrite(tk->U2, sizeof(float), n2, fp) != n2 ||
+              fwrite(tk->U3, sizeof(float), n3, fp) != n3;
+    fclose(fp);
+    return bad ? -1 : 0;
+}
+
+int tucker_load(const char *path, tucker *tk) {
+    memset(tk, 0, sizeof(*tk));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    char magic[4];
+    int head[6];
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, "TUCK", 4) != 0 ||
+        fread(head, sizeof(int), 6, fp) != 6 ||
+        head[0] <= 0 || head[1] <= 0 || head[2] <= 0 || head[3] <= 0 || head[4] <= 0 || head[5] <= 0) {
+        fprintf(stderr, "%s is not a Tucker file (.tuck)\n", path);
+        fclose(fp);
+        return -1;
+    }
+    tk->m = head[0]; tk->n = head[1]; tk->t = head[2];
+    tk->r1 = head[3]; tk->r2 = head[4]; tk->r3 = head[5];
+    size_t ng = (size_t)tk->r3 * tk->r1 * tk->r2;
+    size_t n1 = (size_t)tk->m * tk->r1, n2 = (size_t)tk->n * tk->r2, n3 = (size_t)tk->t * tk->r3;
+    tk->G = (float*)malloc(ng * sizeof(float));
+    tk->U1 = (float*)malloc(n1 * sizeof(float));
+    tk->U2 = (float*)malloc(n2 * sizeof(float));
+    tk->U3 = (float*)malloc(n3 * sizeof(float));
+    int bad = !tk->G || !tk->U1 || !tk->U2 || !tk->U3 ||
+              fread(tk->G, sizeof(float), ng, fp) != ng ||
+              fread(tk->U1, sizeof(float), n1, fp) != n1 ||
+              fread(tk->U2, sizeof(float), n2, fp) != n2 ||
+              fread(tk->U3, sizeof(float), n3, fp) != n3;
+    fclose(fp);
+    if (bad) {
+        fprintf(stderr, "%s is cut short\n", path);
+        tucker_free(tk);
+        return -1;
+    }
+    return 0;
+}
+
+void tucker_free(tucker *tk) {
+    free(tk->G); free(tk->U1); free(tk->U2); free(tk->U3);
+    memset(tk, 0, sizeof(*tk));
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "../c_libs/tune_profile.h"
+
+/* File format (text, '#' starts a comment):
+       m n k b cheb procs threads seconds */
+
+/* Reads a profile, returns 0 on success and -1 if the file cannot be opened */
+int tune_profile_load(const char *path, tune_profile *p) {
+    memset(p, 0, sizeof(*p));
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        tune_entry e;
+        if (sscanf(line, "%d %d %d %d %d %d %d %lf", &e.m, &e.n, &e.k, &e.b,
+                   &e.cheb, &e.procs, &e.threads, &e.seconds) != 8)
+            continue;
+        if (e.m <= 0 || e.n <= 0 || e.k <= 0 || e.b <= 0) continue;
+        if (e.cheb < 1) e.cheb = 1;
+        if (e.procs < 1) e.procs = 1;
+        if (e.threads < 0) e.threads = 0;
+        tune_profile_add(p, &e);
+    }
+    fclose(fp);
+    return 0;
+}
+
+int tune_profile_save(const char *path, const tune_profile *p) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fprintf(fp, "# svd tuning profile\n");
+    fprintf(fp, "# m n k b cheb procs threads seconds\n");
+    for (int i = 0; i < p->count; i++) {
+        const tune_entry *e = &p->entry[i];
+        fprintf(fp, "%d %d %d %d %d %d %d %.6f\n", e->m, e->n, e->k, e->b,
+                e->cheb, e->procs, e->threads, e->seconds);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Adds an entry, a shape that is already there gets replaced */
+int tune_profile_add(tune_profile *p, const tune_entry *e) {
+    for (int i = 0; i < p->count; i++) {
+        tune_entry *old = &p->entry[i];
+        if (old->m == e->m && old->n == e->n && old->k == e->k) {
+            *old = *e;
+            return 0;
+        }
+    }
+    if (p->count >= TUNE_MAX_ENTRIES) return -1;
+    p->entry[p->count++] = *e;
+    return 0;
+}
+
+/* Finds the measured shape closest to (m, n, k). Distance is taken on a log
+   scale so 512 vs 1024 counts the same as 1024 vs 2048.
+   Returns NULL for an empty profile. */
+const tune_entry* tune_profile_lookup(const tune_profile *p, int m, int n, int k) {
+    const tune_entry *best = NULL;
+    double best_d = 0.0;
+    for (int i = 0; i < p->count; i++) {
+        const tune_entry *e = &p->entry[i];
+        double d = fabs(log((double)m / e->m)) + fabs(log((double)n / e->n)) +
+                   fabs(log((double)k / e->k));
+        if (!best || d < best_d) {
+            best = e;
+            best_d = d;
+        }
+    }
+    return best;
+}
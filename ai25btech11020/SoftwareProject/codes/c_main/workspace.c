@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../c_libs/workspace.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define WS_ALIGN 64
+#define WS_HUGEPAGE (2u * 1024 * 1024)
+
+static size_t round_up(size_t x, size_t to) {
+    return (x + to - 1) / to * to;
+}
+
+/* Gets the memory in one go. With use_hugepages the block is first tried
+   as explicit 2 MB pages, then as normal pages with transparent hugepages
+   requested. Returns 0 on success, -1 on failure. */
+int workspace_init(workspace *ws, size_t bytes, int use_hugepages) {
+    memset(ws, 0, sizeof(*ws));
+    bytes = round_up(bytes ? bytes : WS_ALIGN, WS_ALIGN);
+
+#ifdef __linux__
+    // mmap gives page aligned memory that is not touched yet,
+    // so pages land where the first thread writing them runs
+    void *p = MAP_FAILED;
+    if (use_hugepages) {
+        size_t hbytes = round_up(bytes, WS_HUGEPAGE);
+        p = mmap(NULL, hbytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            bytes = hbytes;
+            ws->huge = 1;
+        }
+    }
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return -1;
+#ifdef MADV_HUGEPAGE
+        if (use_hugepages) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    ws->base = (char*)p;
+    ws->mapped = 1;
+#elif defined(_WIN32)
+    (void)use_hugepages;
+    ws->base = (char*)_aligned_malloc(bytes, WS_ALIGN);
+    if (!ws->base) return -1;
+#else
+    (void)use_hugepages;
+    void *p = NULL;
+    if (posix_memalign(&p, WS_ALIGN, bytes) != 0) return -1;
+    ws->base = (char*)p;
+#endif
+    ws->size = bytes;
+    return 0;
+}
+
+/* Next 64-byte aligned piece, NULL when the workspace is full */
+void* workspace_alloc(workspace *ws, size_t bytes) {
+    size_t start = round_up(ws->used, WS_ALIGN);
+    if (!ws->base || start + bytes > ws->size) {
+        fprintf(stderr, "Error: workspace too small (%zu of %zu bytes used, %zu asked)\n",
+                ws->used, ws->size, bytes);
+        return NULL;
+    }
+    ws->used = start + bytes;
+    return ws->base + start;
+}
+
+/* mark/rewind give back everything allocated after the mark */
+size_t workspace_mark(const workspace *ws) {
+    return ws->used;
+}
+
+void workspace_rewind(workspace *ws, size_t mark) {
+    if (mark <= ws->used) ws->used = mark;
+}
+
+void workspace_free(workspace *ws) {
+    if (!ws->base) return;
+#ifdef __linux__
+    munmap(ws->base, ws->size);
+#elif defined(_WIN32)
+    _aligned_free(ws->base);
+#else
+    free(ws->base);
+#endif
+    memset(ws, 0, sizeof(*ws));
+}
+
+/* A_res, A_app, A_vis (m×n each), V, Z (n×bmax), Y (m×bmax),
+   W (n×2bmax, only with the Chebyshev filter) and PrevV (n×k),
+   plus the alignment padding of every piece */
+size_t workspace_bytes_for_job(int m, int n, int k, int bmax, int cheb) {
+    size_t count = (size_t)m * n;
+    size_t floats = 3 * count + 2 * (size_t)n * bmax + (size_t)m * bmax + (size_t)n * k;
+    if (cheb) floats += 2 * (size_t)n * bmax;
+    return floats * sizeof(float) + 8 * WS_ALIGN;
+}